@@ -0,0 +1,43 @@
+#include "binary_matrix.h"
+#include <algorithm>
+
+void BinaryMatrix::reset(int dim) {
+    clear();
+    m_dim = dim;
+    m_words = wordsFor(dim);
+}
+
+void BinaryMatrix::clear() {
+    m_dim = 0;
+    m_words = 0;
+    m_rows = 0;
+    m_bits.clear();
+}
+
+void BinaryMatrix::reserve(int rows) {
+    m_bits.reserve(rows * m_words);
+}
+
+int BinaryMatrix::append(const float* vec) {
+    if (m_dim <= 0) return -1;
+    m_bits.resize((m_rows + 1) * m_words);
+    encode(vec, m_dim, m_bits.data() + (size_t)m_rows * m_words);
+    return m_rows++;
+}
+
+int BinaryMatrix::appendSketch(const uint64_t* sketch) {
+    if (m_dim <= 0) return -1;
+    m_bits.resize((m_rows + 1) * m_words);
+    std::copy(sketch, sketch + m_words, m_bits.data() + (size_t)m_rows * m_words);
+    return m_rows++;
+}
+
+void BinaryMatrix::encode(const float* vec, int n, uint64_t* out) {
+    for (int w = 0; w < wordsFor(n); ++w) {
+        uint64_t bits = 0;
+        const int end = qMin(64, n - w * 64);
+        const float* v = vec + w * 64;
+        for (int i = 0; i < end; ++i) bits |= (uint64_t)(v[i] > 0.0f) << i;
+        out[w] = bits;
+    }
+}
@@ -0,0 +1,36 @@
+#ifndef BINARY_MATRIX_H
+#define BINARY_MATRIX_H
+
+#include <QVector>
+#include <cstdint>
+
+// Resident 1-bit sketch of every embedding: bit i is set when component i is positive.
+// For unit vectors the Hamming distance between sketches tracks the angle between them
+// (cos ~= cos(pi * hamming / dim)), so a popcount scan is a cheap first-stage shortlist.
+// A 3072-dim row is 48 words (384 bytes) instead of 12 KB.
+class BinaryMatrix {
+public:
+    void reset(int dim);
+    void clear();
+    void reserve(int rows);
+    int append(const float* vec); // Returns the row ordinal
+    int appendSketch(const uint64_t* sketch); // An already encoded row of words() words
+
+    int dimension() const { return m_dim; }
+    int words() const { return m_words; }
+    int rows() const { return m_rows; }
+
+    const uint64_t* row(int r) const { return m_bits.constData() + (size_t)r * m_words; }
+
+    // out must hold wordsFor(n) words
+    static int wordsFor(int n) { return (n + 63) / 64; }
+    static void encode(const float* vec, int n, uint64_t* out);
+
+private:
+    int m_dim = 0;
+    int m_words = 0;
+    int m_rows = 0;
+    QVector<uint64_t> m_bits; // rows x words
+};
+
+#endif // BINARY_MATRIX_H
@@ -0,0 +1,138 @@
+#include "federated_search.h"
+#include <QtConcurrent>
+#include <QFuture>
+#include <QElapsedTimer>
+#include <QDebug>
+#include <QtMath>
+#include <algorithm>
+
+FederatedSearch::FederatedSearch(QObject *parent) : QObject(parent) {
+    m_pool.setMaxThreadCount(QThread::idealThreadCount());
+}
+
+FederatedSearch::~FederatedSearch() {
+    m_pool.waitForDone();
+    for (const Workspace& ws : m_workspaces) {
+        if (ws.owned) ws.store->close();
+    }
+}
+
+bool FederatedSearch::addWorkspace(const QString& name, const QString& dbPath) {
+    if (store(name)) return false;
+    VectorStore* vs = new VectorStore(dbPath, this);
+    if (!vs->init()) {
+        qDebug() << "Federated search: could not open workspace" << name << dbPath;
+        delete vs;
+        return false;
+    }
+    m_workspaces.append({name, vs, true});
+    // One pool thread per workspace, so no query waits behind another workspace's
+    m_pool.setMaxThreadCount(qMax(QThread::idealThreadCount(), (int)m_workspaces.size()));
+    return true;
+}
+
+bool FederatedSearch::addWorkspace(const QString& name, VectorStore* vs) {
+    if (!vs || store(name)) return false;
+    m_workspaces.append({name, vs, false});
+    m_pool.setMaxThreadCount(qMax(QThread::idealThreadCount(), (int)m_workspaces.size()));
+    return true;
+}
+
+void FederatedSearch::removeWorkspace(const QString& name) {
+    for (int i = 0; i < m_workspaces.size(); ++i) {
+        if (m_workspaces[i].name != name) continue;
+        Workspace ws = m_workspaces.takeAt(i);
+        if (ws.owned) {
+            ws.store->close();
+            delete ws.store;
+        }
+        return;
+    }
+}
+
+QStringList FederatedSearch::workspaces() const {
+    QStringList names;
+    for (const Workspace& ws : m_workspaces) names << ws.name;
+    return names;
+}
+
+VectorStore* FederatedSearch::store(const QString& name) const {
+    for (const Workspace& ws : m_workspaces) {
+        if (ws.name == name) return ws.store;
+    }
+    return nullptr;
+}
+
+QVector<FederatedHit> FederatedSearch::search(const QVector<float>& queryEmbedding, int limit, const SearchOptions& options) {
+    return fanOut(limit, ScoreNormalization::Raw, [queryEmbedding, limit, options](VectorStore* vs) {
+        return vs->search(queryEmbedding, limit, options);
+    });
+}
+
+QVector<FederatedHit> FederatedSearch::hybridSearch(const QString& queryText, const QVector<float>& queryEmbedding, const SearchOptions& options) {
+    return fanOut(options.limit, m_normalization, [queryText, queryEmbedding, options](VectorStore* vs) {
+        return vs->hybridSearch(queryText, queryEmbedding, options);
+    });
+}
+
+template <typename Fn>
+QVector<FederatedHit> FederatedSearch::fanOut(int limit, ScoreNormalization mode, const Fn& runOne) {
+    QElapsedTimer timer;
+    timer.start();
+
+    // Every workspace starts before any result is awaited
+    QVector<QFuture<QVector<VectorEntry>>> futures;
+    futures.reserve(m_workspaces.size());
+    for (const Workspace& ws : m_workspaces) {
+        VectorStore* vs = ws.store;
+        futures.append(QtConcurrent::run(&m_pool, [runOne, vs]() { return runOne(vs); }));
+    }
+
+    // Normalized per workspace, then concatenated in workspace order so ties stay stable
+    QVector<FederatedHit> merged;
+    for (int w = 0; w < futures.size(); ++w) {
+        QVector<FederatedHit> hits;
+        for (const VectorEntry& e : futures[w].result()) {
+            FederatedHit hit;
+            hit.workspace = m_workspaces[w].name;
+            hit.entry = e;
+            hit.rawScore = e.score;
+            hits.append(hit);
+        }
+        normalize(hits, mode);
+        merged += hits;
+    }
+
+    std::stable_sort(merged.begin(), merged.end(), [](const FederatedHit& a, const FederatedHit& b) {
+        return a.entry.score > b.entry.score;
+    });
+    if (limit >= 0 && merged.size() > limit) merged.resize(limit);
+
+    qDebug() << "Federated search:" << m_workspaces.size() << "workspaces," << merged.size()
+             << "hits in" << timer.elapsed() << "ms";
+    return merged;
+}
+
+void FederatedSearch::normalize(QVector<FederatedHit>& hits, ScoreNormalization mode) {
+    if (hits.isEmpty() || mode == ScoreNormalization::Raw) return;
+
+    double lo = hits[0].rawScore, hi = hits[0].rawScore, sum = 0.0;
+    for (const FederatedHit& h : hits) {
+        lo = qMin(lo, h.rawScore);
+        hi = qMax(hi, h.rawScore);
+        sum += h.rawScore;
+    }
+
+    if (mode == ScoreNormalization::MinMax) {
+        // A single hit (or all tied) has no spread to scale: it counts as the workspace's best
+        const double range = hi - lo;
+        for (FederatedHit& h : hits) h.entry.score = range > 0.0 ? (h.rawScore - lo) / range : 1.0;
+        return;
+    }
+
+    const double mean = sum / hits.size();
+    double var = 0.0;
+    for (const FederatedHit& h : hits) var += (h.rawScore - mean) * (h.rawScore - mean);
+    const double stddev = qSqrt(var / hits.size());
+    for (FederatedHit& h : hits) h.entry.score = stddev > 0.0 ? (h.rawScore - mean) / stddev : 0.0;
+}
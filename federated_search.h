@@ -0,0 +1,68 @@
+#ifndef FEDERATED_SEARCH_H
+#define FEDERATED_SEARCH_H
+
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <QThreadPool>
+#include "vector_store.h"
+
+// How each workspace's hybrid scores are rescaled before the lists are merged. Cosine
+// scores are already comparable across workspaces sharing a model, so search() merges them
+// Raw; fused hybrid scores depend on each workspace's own lists and are not.
+enum class ScoreNormalization {
+    Raw,    // Merge as returned
+    MinMax, // Per workspace onto [0, 1]
+    ZScore  // Per workspace: (score - mean) / stddev
+};
+
+struct FederatedHit {
+    QString workspace;
+    VectorEntry entry;  // entry.score holds the normalized score the merge ranked by
+    double rawScore = 0.0;
+};
+
+// Searches several workspaces (.sqlite files) as one corpus. Every store stays open; a query
+// runs on all of them at once on a dedicated pool, so the merged answer costs about as much
+// as the slowest workspace. Each store still parallelizes its own scan on its own pool.
+// Stores must not be closed or re-pointed while a federated search is running.
+class FederatedSearch : public QObject {
+    Q_OBJECT
+public:
+    explicit FederatedSearch(QObject *parent = nullptr);
+    ~FederatedSearch();
+
+    // Opens dbPath in a store owned by this object; false if the name is taken or init() fails
+    bool addWorkspace(const QString& name, const QString& dbPath);
+    // Borrows an already open store (e.g. the one MainWindow shows); it is never closed here
+    bool addWorkspace(const QString& name, VectorStore* store);
+    void removeWorkspace(const QString& name);
+    QStringList workspaces() const;
+    VectorStore* store(const QString& name) const;
+
+    // Applies to hybridSearch() only; search() always merges the raw cosine scores
+    void setNormalization(ScoreNormalization mode) { m_normalization = mode; }
+    ScoreNormalization normalization() const { return m_normalization; }
+
+    // Top `limit` over every workspace; each one contributes at most `limit` candidates
+    QVector<FederatedHit> search(const QVector<float>& queryEmbedding, int limit = 5, const SearchOptions& options = SearchOptions());
+    QVector<FederatedHit> hybridSearch(const QString& queryText, const QVector<float>& queryEmbedding, const SearchOptions& options = SearchOptions());
+
+private:
+    struct Workspace {
+        QString name;
+        VectorStore* store = nullptr;
+        bool owned = false;
+    };
+
+    template <typename Fn>
+    QVector<FederatedHit> fanOut(int limit, ScoreNormalization mode, const Fn& runOne);
+    static void normalize(QVector<FederatedHit>& hits, ScoreNormalization mode);
+
+    QVector<Workspace> m_workspaces;
+    QThreadPool m_pool;
+    ScoreNormalization m_normalization = ScoreNormalization::MinMax; // hybridSearch() only
+};
+
+#endif // FEDERATED_SEARCH_H
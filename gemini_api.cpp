@@ -1,4 +1,5 @@
 #include "gemini_api.h"
+#include "simd_kernels.h"
 #include <QtConcurrent/QtConcurrent>
 #include <QFuture>
 #include <cmath>
@@ -379,13 +380,7 @@ void GeminiApi::generateSummary(const QString& text, const QMap<QString, QVarian
 void GeminiApi::synthesizeResponse(const QString& query, const QVector<SourceContext>& contexts, const QMap<QString, QVariant>& metadata) {
     auto cosineSim = [](const QVector<float>& v1, const QVector<float>& v2) -> float {
         if (v1.isEmpty() || v2.isEmpty() || v1.size() != v2.size()) return 0.0f;
-        double dot = 0.0, n1 = 0.0, n2 = 0.0;
-        for (int i = 0; i < v1.size(); ++i) {
-            dot += v1[i] * v2[i];
-            n1 += v1[i] * v1[i];
-            n2 += v2[i] * v2[i];
-        }
-        return (n1 > 0 && n2 > 0) ? (float)(dot / (sqrt(n1) * sqrt(n2))) : 0.0f;
+        return SimdKernels::cosine(v1.constData(), v2.constData(), v1.size());
     };
 
     // Phase 4.2: Semantic Fact Clustering
@@ -577,6 +572,7 @@ void GeminiApi::onEmbeddingsReply(QNetworkReply* reply, const QString& originalT
         }
         
         emit errorOccurred("Embedding error: " + errorMsg);
+        emit embeddingFailed(originalText, metadata);
         reply->deleteLater();
         return;
     }
@@ -614,6 +610,7 @@ void GeminiApi::onEmbeddingsReply(QNetworkReply* reply, const QString& originalT
 
     if (embedding.isEmpty()) {
         emit errorOccurred("Embeddings returned empty. Please verify you are using an embedding-compatible model in your local AI server.");
+        emit embeddingFailed(originalText, metadata);
     } else {
         QMap<QString, QVariant> finalMetadata = metadata;
         finalMetadata["model_sig"] = m_embedModel.name.isEmpty() ? (m_localMode == 1 ? "nomic-embed-text" : "gemini-embedding-001") : m_embedModel.name;
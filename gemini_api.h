@@ -90,6 +90,7 @@ signals:
     void anomalyDetected(const QString& title, const QString& message);
     void discoveredModelsReady(const QVector<ModelInfo>& models);
     void errorOccurred(const QString& error);
+    void embeddingFailed(const QString& text, const QMap<QString, QVariant>& metadata); // Sent with errorOccurred
 
 private slots:
     void onEmbeddingsReply(QNetworkReply* reply, const QString& originalText, const QMap<QString, QVariant>& metadata);
@@ -0,0 +1,376 @@
+#include "hnsw_index.h"
+#include "simd_kernels.h"
+#include <QFile>
+#include <QDataStream>
+#include <QDebug>
+#include <cmath>
+#include <queue>
+#include <vector>
+
+namespace {
+
+const quint32 kHnswMagic = 0x484E5357; // "HNSW"
+const quint32 kHnswVersion = 1;
+
+// Per-thread visited tags; bumping the epoch resets them without a clear
+thread_local QVector<quint32> t_visited;
+thread_local quint32 t_epoch = 0;
+
+quint32 beginVisit(int nodes) {
+    if (t_visited.size() < nodes) t_visited.resize(nodes);
+    if (++t_epoch == 0) { // Wrapped: tags from 4 billion searches ago would alias
+        t_visited.fill(0);
+        t_epoch = 1;
+    }
+    return t_epoch;
+}
+
+// Every id a search could follow must name a node that has the layer it is reached on;
+// a sidecar that fails this would index past the graph arrays
+bool validGraph(const QVector<int>& levels, const QVector<int>& links0, const QVector<QVector<int>>& upper,
+                int m, int entryPoint, int maxLevel) {
+    const int n = levels.size();
+    if (n == 0) return entryPoint == -1 && maxLevel == -1;
+    if (entryPoint < 0 || entryPoint >= n || maxLevel < 0 || levels[entryPoint] != maxLevel) return false;
+
+    auto validList = [&](const int* list, int capacity, int level) {
+        if (list[0] < 0 || list[0] > capacity) return false;
+        for (int i = 1; i <= list[0]; ++i) {
+            if (list[i] < 0 || list[i] >= n || levels[list[i]] < level) return false;
+        }
+        return true;
+    };
+    for (int node = 0; node < n; ++node) {
+        const int level = levels[node];
+        if (level < 0 || level > maxLevel || upper[node].size() != level * (m + 1)) return false;
+        if (!validList(links0.constData() + (size_t)node * (2 * m + 1), 2 * m, 0)) return false;
+        for (int l = 1; l <= level; ++l) {
+            if (!validList(upper[node].constData() + (l - 1) * (m + 1), m, l)) return false;
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+HnswIndex::HnswIndex(const HnswParams& params, unsigned int seed)
+    : m_params(params), m_rng(seed) {
+    m_params.M = qMax(2, m_params.M);
+    m_levelMult = 1.0 / std::log((double)m_params.M);
+}
+
+void HnswIndex::clear() {
+    m_entryPoint = -1;
+    m_maxLevel = -1;
+    m_levels.clear();
+    m_links0.clear();
+    m_upperLinks.clear();
+}
+
+int* HnswIndex::links(int node, int level) {
+    if (level == 0) return m_links0.data() + (size_t)node * (2 * m_params.M + 1);
+    return m_upperLinks[node].data() + (level - 1) * (m_params.M + 1);
+}
+
+const int* HnswIndex::links(int node, int level) const {
+    if (level == 0) return m_links0.constData() + (size_t)node * (2 * m_params.M + 1);
+    return m_upperLinks[node].constData() + (level - 1) * (m_params.M + 1);
+}
+
+int HnswIndex::randomLevel() {
+    std::uniform_real_distribution<double> dist(0.0, 1.0);
+    double u = qMax(dist(m_rng), 1e-12);
+    return (int)(-std::log(u) * m_levelMult);
+}
+
+QVector<HnswIndex::Candidate> HnswIndex::searchLayer(const VectorMatrix& matrix, const float* query, int entry, int ef, int level, const RowBitmap* filter) const {
+    auto bestFirst = [](const Candidate& a, const Candidate& b) { return a.sim < b.sim; };
+    auto worstFirst = [](const Candidate& a, const Candidate& b) { return a.sim > b.sim; };
+    std::priority_queue<Candidate, std::vector<Candidate>, decltype(bestFirst)> frontier(bestFirst);
+    std::priority_queue<Candidate, std::vector<Candidate>, decltype(worstFirst)> found(worstFirst);
+
+    const int dim = matrix.dimension();
+    quint32 tag = beginVisit(m_levels.size());
+
+    Candidate start{SimdKernels::dot(query, matrix.row(entry), dim), entry};
+    frontier.push(start);
+    if (!filter || filter->test(entry)) found.push(start);
+    t_visited[entry] = tag;
+
+    while (!frontier.empty()) {
+        Candidate c = frontier.top();
+        if ((int)found.size() >= ef && c.sim < found.top().sim) break;
+        frontier.pop();
+
+        const int* nb = links(c.node, level);
+        for (int i = 1; i <= nb[0]; ++i) {
+            int n = nb[i];
+            if (t_visited[n] == tag) continue;
+            t_visited[n] = tag;
+
+            float sim = SimdKernels::dot(query, matrix.row(n), dim);
+            if ((int)found.size() < ef || sim > found.top().sim) {
+                // Filtered-out nodes still route the walk but never enter the result set
+                frontier.push({sim, n});
+                if (filter && !filter->test(n)) continue;
+                found.push({sim, n});
+                if ((int)found.size() > ef) found.pop();
+            }
+        }
+    }
+
+    QVector<Candidate> result(found.size());
+    for (int i = result.size() - 1; i >= 0; --i) {
+        result[i] = found.top();
+        found.pop();
+    }
+    return result; // Best first
+}
+
+QVector<int> HnswIndex::selectNeighbors(const VectorMatrix& matrix, QVector<Candidate> candidates, int maxCount) const {
+    std::sort(candidates.begin(), candidates.end(), [](const Candidate& a, const Candidate& b) { return a.sim > b.sim; });
+
+    // Heuristic selection: keep a candidate only if it is closer to the base node than
+    // to every neighbour already kept, which preserves links towards distinct regions
+    const int dim = matrix.dimension();
+    QVector<int> selected;
+    for (const Candidate& c : candidates) {
+        if (selected.size() >= maxCount) break;
+        bool diverse = true;
+        for (int s : selected) {
+            if (SimdKernels::dot(matrix.row(c.node), matrix.row(s), dim) > c.sim) {
+                diverse = false;
+                break;
+            }
+        }
+        if (diverse) selected.append(c.node);
+    }
+    return selected;
+}
+
+void HnswIndex::connect(const VectorMatrix& matrix, int node, int level, const QVector<int>& neighbors) {
+    const int dim = matrix.dimension();
+    const int cap = maxLinks(level);
+
+    int* own = links(node, level);
+    own[0] = neighbors.size();
+    for (int i = 0; i < neighbors.size(); ++i) own[i + 1] = neighbors[i];
+
+    for (int n : neighbors) {
+        int* nb = links(n, level);
+        if (nb[0] < cap) {
+            nb[++nb[0]] = node;
+            continue;
+        }
+        // Neighbour is full: re-select among its current links plus the new node
+        QVector<Candidate> pool;
+        pool.reserve(cap + 1);
+        const float* base = matrix.row(n);
+        for (int i = 1; i <= nb[0]; ++i) pool.append({SimdKernels::dot(base, matrix.row(nb[i]), dim), nb[i]});
+        pool.append({SimdKernels::dot(base, matrix.row(node), dim), node});
+
+        QVector<int> kept = selectNeighbors(matrix, pool, cap);
+        nb[0] = kept.size();
+        for (int i = 0; i < kept.size(); ++i) nb[i + 1] = kept[i];
+    }
+}
+
+void HnswIndex::add(const VectorMatrix& matrix, int row) {
+    if (row != size() || row >= matrix.rows()) return;
+
+    int level = randomLevel();
+    m_levels.append(level);
+    m_links0.resize(m_links0.size() + 2 * m_params.M + 1);
+    links(row, 0)[0] = 0;
+    m_upperLinks.append(QVector<int>(level * (m_params.M + 1), 0));
+
+    if (m_entryPoint < 0) {
+        m_entryPoint = row;
+        m_maxLevel = level;
+        return;
+    }
+
+    const int dim = matrix.dimension();
+    const float* q = matrix.row(row);
+    int cur = m_entryPoint;
+    float curSim = SimdKernels::dot(q, matrix.row(cur), dim);
+
+    // Greedy descent through layers above the new node's top layer
+    for (int l = m_maxLevel; l > level; --l) {
+        bool changed = true;
+        while (changed) {
+            changed = false;
+            const int* nb = links(cur, l);
+            for (int i = 1; i <= nb[0]; ++i) {
+                float sim = SimdKernels::dot(q, matrix.row(nb[i]), dim);
+                if (sim > curSim) {
+                    curSim = sim;
+                    cur = nb[i];
+                    changed = true;
+                }
+            }
+        }
+    }
+
+    for (int l = qMin(level, m_maxLevel); l >= 0; --l) {
+        QVector<Candidate> found = searchLayer(matrix, q, cur, m_params.efConstruction, l);
+        connect(matrix, row, l, selectNeighbors(matrix, found, m_params.M));
+        cur = found.first().node;
+    }
+
+    if (level > m_maxLevel) {
+        m_entryPoint = row;
+        m_maxLevel = level;
+    }
+}
+
+std::unique_ptr<IVectorIndex> HnswIndex::compacted(const VectorMatrix& matrix, const QVector<int>& remap) const {
+    auto out = std::make_unique<HnswIndex>(m_params);
+    out->m_rng = m_rng;
+    auto mapped = [&](int node) { return node < remap.size() ? remap[node] : -1; };
+
+    QVector<int> kept; // Old node of each new node
+    for (int n = 0; n < size(); ++n) {
+        if (mapped(n) >= 0) kept.append(n);
+    }
+    out->m_levels.resize(kept.size());
+    out->m_links0.resize(kept.size() * (2 * m_params.M + 1));
+    out->m_upperLinks.resize(kept.size());
+    for (int i = 0; i < kept.size(); ++i) {
+        out->m_levels[i] = m_levels[kept[i]];
+        out->m_upperLinks[i] = QVector<int>(m_levels[kept[i]] * (m_params.M + 1), 0);
+    }
+
+    // Surviving links are renumbered. A node that lost a neighbour re-selects among its
+    // surviving links plus the dead neighbours' surviving links, which bridges the hole
+    // the way hnswlib's repair does, without a full rebuild.
+    const int dim = matrix.dimension();
+    for (int i = 0; i < kept.size(); ++i) {
+        const int old = kept[i];
+        const float* base = matrix.row(i);
+        for (int l = 0; l <= m_levels[old]; ++l) {
+            const int* nb = links(old, l);
+            QVector<int> live;
+            QVector<int> dead;
+            for (int j = 1; j <= nb[0]; ++j) {
+                if (mapped(nb[j]) >= 0) live.append(mapped(nb[j]));
+                else dead.append(nb[j]);
+            }
+            if (!dead.isEmpty()) {
+                QVector<Candidate> pool;
+                auto consider = [&](int node) {
+                    if (node == i) return;
+                    for (const Candidate& c : pool) {
+                        if (c.node == node) return;
+                    }
+                    pool.append({SimdKernels::dot(base, matrix.row(node), dim), node});
+                };
+                for (int n : live) consider(n);
+                for (int d : dead) {
+                    const int* dnb = links(d, l);
+                    for (int j = 1; j <= dnb[0]; ++j) {
+                        if (mapped(dnb[j]) >= 0) consider(mapped(dnb[j]));
+                    }
+                }
+                live = selectNeighbors(matrix, pool, maxLinks(l));
+            }
+            int* own = out->links(i, l);
+            own[0] = live.size();
+            for (int j = 0; j < live.size(); ++j) own[j + 1] = live[j];
+        }
+    }
+
+    if (!kept.isEmpty()) {
+        if (mapped(m_entryPoint) >= 0) {
+            out->m_entryPoint = mapped(m_entryPoint);
+        } else {
+            out->m_entryPoint = 0; // Promote the highest surviving node
+            for (int i = 1; i < kept.size(); ++i) {
+                if (out->m_levels[i] > out->m_levels[out->m_entryPoint]) out->m_entryPoint = i;
+            }
+        }
+        out->m_maxLevel = out->m_levels[out->m_entryPoint];
+    }
+    return out;
+}
+
+QVector<ScoredRow> HnswIndex::search(const VectorMatrix& matrix, const float* query, const IndexQuery& params) const {
+    QVector<ScoredRow> hits;
+    if (m_entryPoint < 0 || params.k <= 0 || matrix.rows() < size()) return hits;
+
+    const int dim = matrix.dimension();
+    int ef = qMax(params.efSearch > 0 ? params.efSearch : m_params.efSearch, params.k);
+    int cur = m_entryPoint;
+    float curSim = SimdKernels::dot(query, matrix.row(cur), dim);
+
+    for (int l = m_maxLevel; l > 0; --l) {
+        bool changed = true;
+        while (changed) {
+            changed = false;
+            const int* nb = links(cur, l);
+            for (int i = 1; i <= nb[0]; ++i) {
+                float sim = SimdKernels::dot(query, matrix.row(nb[i]), dim);
+                if (sim > curSim) {
+                    curSim = sim;
+                    cur = nb[i];
+                    changed = true;
+                }
+            }
+        }
+    }
+
+    QVector<Candidate> found = searchLayer(matrix, query, cur, ef, 0, params.filter);
+    int n = qMin(params.k, found.size());
+    hits.reserve(n);
+    for (int i = 0; i < n; ++i) hits.append({found[i].node, found[i].sim});
+    return hits;
+}
+
+bool HnswIndex::save(const QString& path) const {
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) return false;
+    QDataStream out(&file);
+    out.setVersion(QDataStream::Qt_6_0);
+    out << kHnswMagic << kHnswVersion
+        << (qint32)m_params.M << (qint32)m_params.efConstruction << (qint32)m_params.efSearch
+        << (qint32)m_entryPoint << (qint32)m_maxLevel
+        << m_levels << m_links0 << m_upperLinks;
+    return out.status() == QDataStream::Ok;
+}
+
+bool HnswIndex::load(const QString& path) {
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) return false;
+    QDataStream in(&file);
+    in.setVersion(QDataStream::Qt_6_0);
+
+    quint32 magic = 0, version = 0;
+    qint32 m = 0, efC = 0, efS = 0, ep = -1, maxLevel = -1;
+    in >> magic >> version;
+    if (magic != kHnswMagic || version != kHnswVersion) {
+        qDebug() << "HNSW sidecar has an unknown format:" << path;
+        return false;
+    }
+    in >> m >> efC >> efS >> ep >> maxLevel;
+
+    QVector<int> levels, links0;
+    QVector<QVector<int>> upper;
+    in >> levels >> links0 >> upper;
+    if (in.status() != QDataStream::Ok || m < 2 || efC < 1 || efS < 1
+        || links0.size() != levels.size() * (2 * m + 1) || upper.size() != levels.size()
+        || !validGraph(levels, links0, upper, m, ep, maxLevel)) {
+        qDebug() << "HNSW sidecar is corrupt:" << path;
+        return false;
+    }
+
+    m_params.M = m;
+    m_params.efConstruction = efC;
+    m_params.efSearch = efS;
+    m_levelMult = 1.0 / std::log((double)m);
+    m_entryPoint = ep;
+    m_maxLevel = maxLevel;
+    m_levels = levels;
+    m_links0 = links0;
+    m_upperLinks = upper;
+    return true;
+}
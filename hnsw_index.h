@@ -0,0 +1,58 @@
+#ifndef HNSW_INDEX_H
+#define HNSW_INDEX_H
+
+#include "vector_index.h"
+#include <random>
+
+struct HnswParams {
+    int M = 16;               // Links per node on upper layers (2*M on layer 0)
+    int efConstruction = 200; // Candidate list size while inserting
+    int efSearch = 64;        // Default candidate list size while querying
+};
+
+// Hierarchical Navigable Small World graph (Malkov & Yashunin) over the resident matrix.
+// Node n is matrix row n; the graph is built incrementally as rows are appended.
+class HnswIndex : public IVectorIndex {
+public:
+    explicit HnswIndex(const HnswParams& params = HnswParams(), unsigned int seed = 42);
+
+    QString name() const override { return "hnsw"; }
+    int size() const override { return m_levels.size(); }
+    const HnswParams& params() const { return m_params; }
+
+    void add(const VectorMatrix& matrix, int row) override;
+    void clear() override;
+    QVector<ScoredRow> search(const VectorMatrix& matrix, const float* query, const IndexQuery& params) const override;
+    std::unique_ptr<IVectorIndex> compacted(const VectorMatrix& matrix, const QVector<int>& remap) const override;
+
+    bool save(const QString& path) const override;
+    bool load(const QString& path) override;
+
+private:
+    struct Candidate {
+        float sim;
+        int node;
+    };
+
+    int maxLinks(int level) const { return level == 0 ? 2 * m_params.M : m_params.M; }
+    int* links(int node, int level);
+    const int* links(int node, int level) const;
+    int randomLevel();
+
+    QVector<Candidate> searchLayer(const VectorMatrix& matrix, const float* query, int entry, int ef, int level,
+                                   const RowBitmap* filter = nullptr) const;
+    QVector<int> selectNeighbors(const VectorMatrix& matrix, QVector<Candidate> candidates, int maxCount) const;
+    void connect(const VectorMatrix& matrix, int node, int level, const QVector<int>& neighbors);
+
+    HnswParams m_params;
+    double m_levelMult;
+    std::mt19937 m_rng;
+
+    int m_entryPoint = -1;
+    int m_maxLevel = -1;
+    QVector<int> m_levels;             // Top layer of each node
+    QVector<int> m_links0;             // Layer 0: per node [count, 2*M slots]
+    QVector<QVector<int>> m_upperLinks; // Layers 1..level: per node, per layer [count, M slots]
+};
+
+#endif // HNSW_INDEX_H
@@ -0,0 +1,118 @@
+#include "hybrid_fusion.h"
+#include <algorithm>
+#include <cfloat>
+
+namespace {
+
+inline int slotOf(int id, int mask) {
+    quint32 h = quint32(id) * 2654435761u; // Fibonacci hashing; ids are dense and sequential
+    return int((h ^ (h >> 15)) & quint32(mask));
+}
+
+} // namespace
+
+void HybridFusion::reset(int expected) {
+    m_candidates.resize(0); // Keeps the capacity for the next query
+    m_semanticCount = 0;
+    m_keywordCount = 0;
+    int capacity = 16;
+    while (capacity < 2 * expected) capacity <<= 1; // Load factor stays at or below one half
+    if (capacity > m_table.size()) {
+        m_table.resize(capacity);
+    } else {
+        capacity = m_table.size();
+    }
+    m_table.fill(-1);
+    m_mask = capacity - 1;
+}
+
+void HybridFusion::rehash(int capacity) {
+    m_table.resize(capacity);
+    m_table.fill(-1);
+    m_mask = capacity - 1;
+    for (int i = 0; i < m_candidates.size(); ++i) {
+        int s = slotOf(m_candidates[i].id, m_mask);
+        while (m_table[s] >= 0) s = (s + 1) & m_mask;
+        m_table[s] = i;
+    }
+}
+
+HybridFusion::Candidate& HybridFusion::candidate(int id) {
+    int s = slotOf(id, m_mask);
+    while (m_table[s] >= 0) {
+        Candidate& c = m_candidates[m_table[s]];
+        if (c.id == id) return c;
+        s = (s + 1) & m_mask;
+    }
+    if (2 * (m_candidates.size() + 1) > m_table.size()) {
+        rehash(2 * m_table.size()); // More ids than reset() was told about
+        s = slotOf(id, m_mask);
+        while (m_table[s] >= 0) s = (s + 1) & m_mask;
+    }
+    m_table[s] = m_candidates.size();
+    m_candidates.append({id, 0, 0, 0.0f, 0.0f, 0.0f, 0.0});
+    return m_candidates.last();
+}
+
+void HybridFusion::addSemantic(int id, float score, float bonus) {
+    Candidate& c = candidate(id);
+    if (c.semanticRank > 0) return; // First (best) occurrence wins
+    c.semanticRank = ++m_semanticCount;
+    c.semanticScore = score;
+    c.bonus += bonus;
+}
+
+void HybridFusion::addKeyword(int id, float score) {
+    Candidate& c = candidate(id);
+    if (c.keywordRank > 0) return;
+    c.keywordRank = ++m_keywordCount;
+    c.keywordScore = score;
+}
+
+int HybridFusion::fuse(FusionMethod method, double semanticWeight, double keywordWeight, int n, double rrfK) {
+    // Score ranges of each list, for the normalized methods
+    float semLo = FLT_MAX, semHi = -FLT_MAX, kwLo = FLT_MAX, kwHi = -FLT_MAX;
+    if (method != FusionMethod::Rrf) {
+        for (const Candidate& c : m_candidates) {
+            if (c.semanticRank > 0) {
+                semLo = qMin(semLo, c.semanticScore);
+                semHi = qMax(semHi, c.semanticScore);
+            }
+            if (c.keywordRank > 0) {
+                kwLo = qMin(kwLo, c.keywordScore);
+                kwHi = qMax(kwHi, c.keywordScore);
+            }
+        }
+    }
+    // A list whose scores are all equal (or a single hit) normalizes to 1
+    auto normalized = [](float v, float lo, float hi) { return hi > lo ? double(v - lo) / (hi - lo) : 1.0; };
+
+    for (Candidate& c : m_candidates) {
+        double s = 0.0;
+        const double sem = c.semanticRank > 0 ? semanticWeight : 0.0;
+        const double kw = c.keywordRank > 0 ? keywordWeight : 0.0;
+        switch (method) {
+        case FusionMethod::Rrf:
+            if (c.semanticRank > 0) s += sem / (rrfK + c.semanticRank);
+            if (c.keywordRank > 0) s += kw / (rrfK + c.keywordRank);
+            break;
+        case FusionMethod::WeightedSum:
+            if (c.semanticRank > 0) s += sem * normalized(c.semanticScore, semLo, semHi);
+            if (c.keywordRank > 0) s += kw * normalized(c.keywordScore, kwLo, kwHi);
+            break;
+        case FusionMethod::Max:
+            if (c.semanticRank > 0) s = qMax(s, sem * normalized(c.semanticScore, semLo, semHi));
+            if (c.keywordRank > 0) s = qMax(s, kw * normalized(c.keywordScore, kwLo, kwHi));
+            break;
+        }
+        c.score = s + c.bonus;
+    }
+
+    // The table indexes are stale from here on; reset() before the next query
+    auto better = [](const Candidate& a, const Candidate& b) {
+        return a.score > b.score || (a.score == b.score && a.id < b.id);
+    };
+    const int keep = n < 0 ? m_candidates.size() : qMin(n, (int)m_candidates.size());
+    std::partial_sort(m_candidates.begin(), m_candidates.begin() + keep, m_candidates.end(), better);
+    return keep;
+}
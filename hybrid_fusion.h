@@ -0,0 +1,51 @@
+#ifndef HYBRID_FUSION_H
+#define HYBRID_FUSION_H
+
+#include <QVector>
+
+enum class FusionMethod {
+    Rrf,         // Reciprocal rank: weight / (k + rank) per list
+    WeightedSum, // Weighted sum of the per-list min-max normalized scores
+    Max          // Larger of the two weighted normalized scores
+};
+
+// Fuses the semantic and keyword candidate lists of one hybrid query. Candidates sit in a
+// dense array, found by id through a flat open-addressing table (linear probing, power-of-two
+// capacity). reset() keeps both allocations, so an instance kept per thread fuses without
+// allocating once it has seen its largest query; nothing is materialized per candidate.
+class HybridFusion {
+public:
+    struct Candidate {
+        int id;
+        int semanticRank;    // 1-based; 0 = not in that list
+        int keywordRank;
+        float semanticScore;
+        float keywordScore;
+        float bonus;         // Added to the fused score whatever the method (intent boost)
+        double score;        // Set by fuse()
+    };
+
+    void reset(int expected); // Drops the candidates, sizes the table for `expected` ids
+
+    // Each list in rank order, best first; an id seen in both lists is one candidate
+    void addSemantic(int id, float score, float bonus = 0.0f);
+    void addKeyword(int id, float score);
+
+    // Scores every candidate and moves the best `n` (all when n < 0) to the front of
+    // candidates(), best first, ties towards the lower id. Returns how many that is.
+    int fuse(FusionMethod method, double semanticWeight, double keywordWeight, int n, double rrfK = 60.0);
+
+    const QVector<Candidate>& candidates() const { return m_candidates; }
+
+private:
+    Candidate& candidate(int id);
+    void rehash(int capacity);
+
+    QVector<int> m_table; // Index into m_candidates; -1 = empty
+    QVector<Candidate> m_candidates;
+    int m_mask = 0;
+    int m_semanticCount = 0;
+    int m_keywordCount = 0;
+};
+
+#endif // HYBRID_FUSION_H
@@ -0,0 +1,305 @@
+#include "inverted_index.h"
+#include <QtMath>
+#include <algorithm>
+#include <climits>
+
+namespace {
+
+// FTS5 bm25() constants
+const float kK1 = 1.2f;
+const float kB = 0.75f;
+const int kEnd = INT_MAX; // Cursor past its last posting
+
+void putVarint(QByteArray& out, quint32 v) {
+    while (v >= 0x80) {
+        out.append(char(v | 0x80));
+        v >>= 7;
+    }
+    out.append(char(v));
+}
+
+quint32 getVarint(const uchar*& p) {
+    quint32 v = *p & 0x7F;
+    for (int shift = 7; *p++ & 0x80; shift += 7) v |= quint32(*p & 0x7F) << shift;
+    return v;
+}
+
+quint16 clampTf(int tf) {
+    return quint16(qMin(tf, 0xFFFF));
+}
+
+} // namespace
+
+// One query term walking its posting list. `block` is the decoded block under `pos`;
+// `shallow` only moves the block bound along (no decoding) for the BlockMax check.
+struct InvertedIndex::Cursor {
+    const PostingList* list = nullptr;
+    float idf = 0.0f;
+    float bound = 0.0f; // Whole-list score bound
+    int blocks = 0;
+    int block = -1;
+    int shallow = 0;
+    int pos = 0;
+    int count = 0;
+    int id = kEnd;
+    Posting buf[kBlockSize];
+
+    void load(int b) {
+        block = b;
+        pos = 0;
+        if (b >= blocks) {
+            id = kEnd;
+            return;
+        }
+        count = decodeBlock(*list, b, buf);
+        id = buf[0].id;
+    }
+    void next() {
+        if (++pos < count) id = buf[pos].id;
+        else load(block + 1);
+    }
+    void seek(int target) {
+        if (id >= target) return;
+        int b = qMax(block, shallow);
+        while (b < blocks && blockMeta(*list, b).lastId < target) ++b;
+        if (b != block) load(b);
+        if (id == kEnd) return;
+        while (buf[pos].id < target) ++pos; // The block's last id is >= target
+        id = buf[pos].id;
+    }
+    // Moves the block bound to the block that would hold `target`; false past the end
+    bool shallowSeek(int target) {
+        while (shallow < blocks && blockMeta(*list, shallow).lastId < target) ++shallow;
+        return shallow < blocks;
+    }
+};
+
+InvertedIndex::InvertedIndex(float headingWeight, float textWeight)
+    : m_headingWeight(headingWeight), m_textWeight(textWeight) {}
+
+void InvertedIndex::clear() {
+    m_termIds.clear();
+    m_lists.clear();
+    m_lengths.clear();
+    m_removed = RowBitmap();
+    m_lastId = 0;
+    m_docCount = 0;
+    m_totalLength = 0;
+}
+
+QStringList InvertedIndex::tokenize(const QString& text) {
+    // unicode61 (remove_diacritics) drops the marks of a decomposed letter: NFD, then skip
+    // the nonspacing marks without ending the token. ASCII text needs no decomposition
+    bool ascii = true;
+    for (QChar c : text) {
+        if (c.unicode() >= 0x80) {
+            ascii = false;
+            break;
+        }
+    }
+    const QString decomposed = ascii ? text : text.normalized(QString::NormalizationForm_D);
+
+    QStringList tokens;
+    QString current;
+    for (QChar c : decomposed) {
+        if (c.category() == QChar::Mark_NonSpacing) continue;
+        if (c.isLetterOrNumber()) {
+            current += c.toLower();
+        } else if (!current.isEmpty()) {
+            tokens << current;
+            current.clear();
+        }
+    }
+    if (!current.isEmpty()) tokens << current;
+    return tokens;
+}
+
+int InvertedIndex::countTerms(const QString& headingPath, const QString& text, QHash<QString, QPair<int, int>>& counts) {
+    const QStringList heading = tokenize(headingPath);
+    const QStringList body = tokenize(text);
+    for (const QString& t : heading) counts[t].first++;
+    for (const QString& t : body) counts[t].second++;
+    return heading.size() + body.size();
+}
+
+void InvertedIndex::add(int id, const QString& headingPath, const QString& text) {
+    if (id <= m_lastId) return; // Postings must stay in id order
+    QHash<QString, QPair<int, int>> counts;
+    const int length = countTerms(headingPath, text, counts);
+    if (counts.isEmpty()) return;
+
+    for (auto it = counts.constBegin(); it != counts.constEnd(); ++it) {
+        int termId = m_termIds.value(it.key(), -1);
+        if (termId < 0) {
+            termId = m_lists.size();
+            m_termIds.insert(it.key(), termId);
+            m_lists.append(PostingList());
+        }
+        PostingList& list = m_lists[termId];
+        const Posting p{id, clampTf(it.value().first), clampTf(it.value().second)};
+        const float tf = weightedTf(p);
+
+        BlockMeta& meta = list.tailMeta;
+        list.minLength = list.tail.isEmpty() && list.blocks.isEmpty() ? length : qMin(list.minLength, length);
+        list.maxTf = qMax(list.maxTf, tf);
+        meta.minLength = meta.count == 0 ? length : qMin(meta.minLength, length);
+        meta.maxTf = qMax(meta.maxTf, tf);
+        meta.lastId = id;
+        meta.count++;
+        list.tail.append(p);
+        list.docFreq++;
+        if (list.tail.size() == kBlockSize) seal(list);
+    }
+
+    if (id >= m_lengths.size()) m_lengths.resize(id + 1);
+    m_lengths[id] = length;
+    m_lastId = id;
+    m_docCount++;
+    m_totalLength += length;
+}
+
+void InvertedIndex::remove(int id, const QString& headingPath, const QString& text) {
+    if (id <= 0 || id >= m_lengths.size() || m_lengths[id] == 0 || m_removed.test(id)) return;
+    QHash<QString, QPair<int, int>> counts;
+    countTerms(headingPath, text, counts);
+    for (auto it = counts.constBegin(); it != counts.constEnd(); ++it) {
+        const int termId = m_termIds.value(it.key(), -1);
+        if (termId >= 0) m_lists[termId].docFreq--;
+    }
+    // Block bounds stay as they were: still upper bounds over the rows that remain
+    m_removed.set(id);
+    m_docCount--;
+    m_totalLength -= m_lengths[id];
+}
+
+void InvertedIndex::seal(PostingList& list) {
+    BlockMeta meta = list.tailMeta;
+    meta.offset = list.bytes.size();
+    int base = list.blocks.isEmpty() ? 0 : list.blocks.last().lastId;
+    for (const Posting& p : list.tail) {
+        putVarint(list.bytes, quint32(p.id - base));
+        putVarint(list.bytes, p.headingTf);
+        putVarint(list.bytes, p.textTf);
+        base = p.id;
+    }
+    list.blocks.append(meta);
+    list.tail.clear();
+    list.tailMeta = BlockMeta();
+}
+
+int InvertedIndex::decodeBlock(const PostingList& list, int b, Posting* out) {
+    if (b >= list.blocks.size()) {
+        std::copy(list.tail.constBegin(), list.tail.constEnd(), out);
+        return list.tail.size();
+    }
+    const BlockMeta& meta = list.blocks[b];
+    const uchar* p = reinterpret_cast<const uchar*>(list.bytes.constData()) + meta.offset;
+    int id = b > 0 ? list.blocks[b - 1].lastId : 0;
+    for (int i = 0; i < meta.count; ++i) {
+        id += int(getVarint(p));
+        out[i].id = id;
+        out[i].headingTf = quint16(getVarint(p));
+        out[i].textTf = quint16(getVarint(p));
+    }
+    return meta.count;
+}
+
+qint64 InvertedIndex::memoryBytes() const {
+    qint64 bytes = (qint64)m_lengths.size() * sizeof(int);
+    for (const PostingList& list : m_lists) {
+        bytes += sizeof(PostingList) + list.bytes.size() + (qint64)list.blocks.size() * sizeof(BlockMeta)
+               + (qint64)list.tail.size() * sizeof(Posting);
+    }
+    return bytes;
+}
+
+QVector<ScoredRow> InvertedIndex::search(const QString& query, int k, const RowBitmap* allowedIds) const {
+    if (k <= 0 || m_docCount <= 0) return {};
+    const float avgLength = qMax(1.0f, float(m_totalLength) / m_docCount);
+
+    // Same shape as FTS5: idf * f(k1 + 1) / (f + k1(1 - b + b * len / avglen)), f weighted by field
+    auto termScore = [avgLength](float idf, float tf, int length) {
+        return idf * tf * (kK1 + 1.0f) / (tf + kK1 * (1.0f - kB + kB * length / avgLength));
+    };
+
+    QStringList terms = tokenize(query);
+    terms.removeDuplicates();
+    QVector<Cursor> cursors;
+    cursors.reserve(terms.size());
+    for (const QString& term : terms) {
+        const int termId = m_termIds.value(term, -1);
+        if (termId < 0 || m_lists[termId].docFreq <= 0) return {}; // Every term must match
+        const PostingList& list = m_lists[termId];
+        Cursor c;
+        c.list = &list;
+        float idf = qLn((m_docCount - list.docFreq + 0.5) / (list.docFreq + 0.5));
+        c.idf = idf > 0.0f ? idf : 1e-6f; // FTS5 floors non-positive idf the same way
+        c.bound = termScore(c.idf, list.maxTf, list.minLength);
+        c.blocks = blockCount(list);
+        c.load(0);
+        cursors.append(c);
+    }
+    if (cursors.isEmpty()) return {};
+
+    // The rarest term leads; the others only seek to the rows it proposes
+    std::sort(cursors.begin(), cursors.end(), [](const Cursor& a, const Cursor& b) { return a.list->docFreq < b.list->docFreq; });
+    auto blockBound = [&](const Cursor& c) {
+        const BlockMeta& meta = blockMeta(*c.list, c.shallow);
+        return termScore(c.idf, meta.maxTf, meta.minLength);
+    };
+    float reach = 0.0f;
+    for (const Cursor& c : cursors) reach += c.bound;
+
+    TopK top(k);
+    Cursor& lead = cursors[0];
+    int target = lead.id;
+    while (target != kEnd) {
+        const float threshold = top.isFull() ? top.threshold() : 0.0f;
+        if (reach <= threshold) break;
+
+        // Bounds of the blocks that would hold the target: when they can't reach the top k,
+        // no row before the first of those blocks ends can either
+        float blockReach = 0.0f;
+        int blockEnd = kEnd;
+        bool exhausted = false;
+        for (Cursor& c : cursors) {
+            if (!c.shallowSeek(target)) {
+                exhausted = true;
+                break;
+            }
+            blockReach += blockBound(c);
+            blockEnd = qMin(blockEnd, blockMeta(*c.list, c.shallow).lastId + 1);
+        }
+        if (exhausted) break;
+        if (blockReach <= threshold) {
+            lead.seek(blockEnd);
+            target = lead.id;
+            continue;
+        }
+
+        // Every term must sit on the target; one that overshoots proposes the next target
+        int next = target;
+        for (Cursor& c : cursors) {
+            c.seek(target);
+            if (c.id != target) {
+                next = c.id;
+                break;
+            }
+        }
+        if (next != target) {
+            if (next == kEnd) break;
+            lead.seek(next);
+            target = lead.id;
+            continue;
+        }
+
+        if (!m_removed.test(target) && (!allowedIds || allowedIds->test(target))) {
+            float score = 0.0f;
+            for (const Cursor& c : cursors) score += termScore(c.idf, weightedTf(c.buf[c.pos]), m_lengths[target]);
+            top.push(target, score);
+        }
+        lead.next();
+        target = lead.id;
+    }
+    return top.takeSorted();
+}
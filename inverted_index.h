@@ -0,0 +1,87 @@
+#ifndef INVERTED_INDEX_H
+#define INVERTED_INDEX_H
+
+#include <QString>
+#include <QStringList>
+#include <QHash>
+#include <QVector>
+#include <QByteArray>
+#include "row_bitmap.h"
+#include "top_k.h"
+
+// Resident keyword index over (heading_path, text_chunk): the in-process alternative to the
+// embeddings_fts round trip for the keyword stage. Scores follow FTS5's bm25() with column
+// weights (weighted term frequency over the whole row); like the FTS5 MATCH, the query is an
+// AND of its terms, so both paths return the same rows.
+//
+// Postings are keyed by SQLite id, in id order, and sealed in blocks of kBlockSize: id
+// deltas and per-field term frequencies as varints, with the block's last id, largest
+// weighted frequency and shortest row beside it. Those bound the score of every row in
+// the block, so the conjunctive walk can skip whole blocks that cannot reach the current top k.
+class InvertedIndex {
+public:
+    static const int kBlockSize = 128;
+
+    // Defaults match the rank of the FTS5 keyword query
+    explicit InvertedIndex(float headingWeight = 2.0f, float textWeight = 1.0f);
+
+    void clear();
+    // Ids must arrive in ascending order (autoincrement rowids do); others are ignored
+    void add(int id, const QString& headingPath, const QString& text);
+    // Takes the row back out of the statistics; its postings are skipped until a rebuild
+    void remove(int id, const QString& headingPath, const QString& text);
+
+    int documentCount() const { return m_docCount; }
+    int termCount() const { return m_termIds.size(); }
+    qint64 memoryBytes() const;
+
+    // Best first; ScoredRow::row holds the SQLite id. allowedIds (bit per id) restricts when set
+    QVector<ScoredRow> search(const QString& query, int k, const RowBitmap* allowedIds = nullptr) const;
+
+    // Lower-cased letter/digit runs with diacritics folded (e -> e for é), like unicode61
+    static QStringList tokenize(const QString& text);
+
+private:
+    struct Posting {
+        int id;
+        quint16 headingTf;
+        quint16 textTf;
+    };
+    struct BlockMeta {
+        int lastId = 0;
+        int offset = 0;       // Into PostingList::bytes (sealed blocks)
+        int count = 0;
+        float maxTf = 0.0f;   // Largest weighted term frequency in the block
+        int minLength = 0;    // Shortest row (tokens over both fields) in the block
+    };
+    struct PostingList {
+        QByteArray bytes;          // Sealed blocks, back to back
+        QVector<BlockMeta> blocks; // Sealed blocks
+        QVector<Posting> tail;     // Open block, sealed once it holds kBlockSize postings
+        BlockMeta tailMeta;
+        float maxTf = 0.0f;        // Whole-list bound
+        int minLength = 0;
+        int docFreq = 0;           // Live rows containing the term
+    };
+    struct Cursor;
+
+    float weightedTf(const Posting& p) const { return m_headingWeight * p.headingTf + m_textWeight * p.textTf; }
+    void seal(PostingList& list);
+    static int blockCount(const PostingList& list) { return list.blocks.size() + (list.tail.isEmpty() ? 0 : 1); }
+    static const BlockMeta& blockMeta(const PostingList& list, int b) { return b < list.blocks.size() ? list.blocks[b] : list.tailMeta; }
+    static int decodeBlock(const PostingList& list, int b, Posting* out);
+    // Term -> (heading tf, text tf) for one row; returns the row length in tokens
+    static int countTerms(const QString& headingPath, const QString& text, QHash<QString, QPair<int, int>>& counts);
+
+    float m_headingWeight;
+    float m_textWeight;
+    QHash<QString, int> m_termIds;
+    QVector<PostingList> m_lists;
+    QVector<int> m_lengths; // Row length per id (0 = never added)
+    RowBitmap m_removed;    // Ids taken out by remove()
+    int m_lastId = 0;
+    int m_docCount = 0;
+    qint64 m_totalLength = 0;
+};
+
+#endif // INVERTED_INDEX_H
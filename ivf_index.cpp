@@ -0,0 +1,153 @@
+#include "ivf_index.h"
+#include "kmeans.h"
+#include "simd_kernels.h"
+#include <QFile>
+#include <QDataStream>
+#include <QDebug>
+#include <QtMath>
+
+namespace {
+const quint32 kIvfMagic = 0x49564631; // "IVF1"
+const quint32 kIvfVersion = 1;
+}
+
+IvfIndex::IvfIndex(const IvfParams& params) : m_params(params) {}
+
+int IvfIndex::recommendedLists(int rows) {
+    return qBound(16, (int)(4.0 * qSqrt((double)rows)), 65536);
+}
+
+void IvfIndex::clear() {
+    // Keeps the trained centroids: new rows are still assigned without a retrain
+    for (auto& list : m_lists) list.clear();
+    m_size = 0;
+}
+
+void IvfIndex::train(const float* sample, int n, int dim, unsigned int seed, QThreadPool* pool) {
+    if (m_params.nlist <= 0) m_params.nlist = recommendedLists(n);
+    m_dim = dim;
+    m_centroids = KMeans::train(sample, n, dim, m_params.nlist, m_params.iterations, seed, true, pool);
+    m_lists = QVector<QVector<int>>(m_centroids.size() / qMax(1, dim));
+    m_size = 0;
+}
+
+void IvfIndex::add(const VectorMatrix& matrix, int row) {
+    if (!isTrained() || row != m_size || matrix.dimension() != m_dim) return;
+    int list = KMeans::nearest(m_centroids.constData(), m_lists.size(), m_dim, matrix.row(row), true);
+    m_lists[list].append(row);
+    m_size++;
+}
+
+void IvfIndex::addRows(const VectorMatrix& matrix, int end, QThreadPool* pool) {
+    if (!isTrained() || end <= m_size || matrix.dimension() != m_dim) return;
+    // Nearest lists in parallel, appended in row order so every list stays sorted
+    const int begin = m_size;
+    QVector<int> lists(end - begin, -1);
+    KMeans::nearestAll(m_centroids.constData(), m_lists.size(), m_dim, lists.size(),
+                       [&](int i) { return matrix.row(begin + i); }, true, lists.data(), pool);
+    for (int i = 0; i < lists.size(); ++i) m_lists[lists[i]].append(begin + i);
+    m_size = end;
+}
+
+std::unique_ptr<IVectorIndex> IvfIndex::compacted(const VectorMatrix&, const QVector<int>& remap) const {
+    // Centroids stay valid; each list just drops its dead rows and is renumbered in place
+    // (remap is monotonic, so the lists stay sorted by row)
+    auto out = std::make_unique<IvfIndex>(m_params);
+    out->m_dim = m_dim;
+    out->m_centroids = m_centroids;
+    out->m_lists = QVector<QVector<int>>(m_lists.size());
+    for (int l = 0; l < m_lists.size(); ++l) {
+        QVector<int>& list = out->m_lists[l];
+        list.reserve(m_lists[l].size());
+        for (int row : m_lists[l]) {
+            int mapped = row < remap.size() ? remap[row] : -1;
+            if (mapped >= 0) list.append(mapped);
+        }
+        out->m_size += list.size();
+    }
+    return out;
+}
+
+QVector<ScoredRow> IvfIndex::search(const VectorMatrix& matrix, const float* query, const IndexQuery& params) const {
+    if (!isTrained() || params.k <= 0 || matrix.dimension() != m_dim) return {};
+
+    // Coarse stage: closest nprobe centroids. A filter can leave the nearest lists without
+    // a single match, so filtered queries rank every list and keep probing until k is met.
+    int nprobe = qBound(1, params.nprobe > 0 ? params.nprobe : m_params.nprobe, m_lists.size());
+    TopK probes(params.filter ? m_lists.size() : nprobe);
+    for (int c = 0; c < m_lists.size(); ++c) {
+        probes.push(c, SimdKernels::dot(query, m_centroids.constData() + (size_t)c * m_dim, m_dim));
+    }
+
+    // Fine stage: exact dot products inside the probed lists only
+    TopK topK(params.k);
+    int probed = 0;
+    for (const ScoredRow& probe : probes.takeSorted()) {
+        if (probed++ >= nprobe && topK.isFull()) break;
+        for (int row : m_lists[probe.row]) {
+            if (params.filter && !params.filter->test(row)) continue;
+            topK.push(row, SimdKernels::dot(query, matrix.row(row), m_dim));
+        }
+    }
+    return topK.takeSorted();
+}
+
+bool IvfIndex::save(const QString& path) const {
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) return false;
+    QDataStream out(&file);
+    out.setVersion(QDataStream::Qt_6_0);
+    out << kIvfMagic << kIvfVersion
+        << (qint32)m_dim << (qint32)m_size << (qint32)m_params.nprobe
+        << m_centroids << m_lists;
+    return out.status() == QDataStream::Ok;
+}
+
+bool IvfIndex::load(const QString& path) {
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) return false;
+    QDataStream in(&file);
+    in.setVersion(QDataStream::Qt_6_0);
+
+    quint32 magic = 0, version = 0;
+    qint32 dim = 0, size = 0, nprobe = 0;
+    in >> magic >> version;
+    if (magic != kIvfMagic || version != kIvfVersion) {
+        qDebug() << "IVF sidecar has an unknown format:" << path;
+        return false;
+    }
+    QVector<float> centroids;
+    QVector<QVector<int>> lists;
+    in >> dim >> size >> nprobe >> centroids >> lists;
+    if (in.status() != QDataStream::Ok || dim <= 0 || size < 0 || nprobe < 1 || lists.isEmpty()
+        || centroids.size() != lists.size() * dim) {
+        qDebug() << "IVF sidecar is corrupt:" << path;
+        return false;
+    }
+    // Every row below `size` sits in exactly one list, and each list is in row order
+    RowBitmap seen(size);
+    int listed = 0;
+    for (const QVector<int>& list : lists) {
+        for (int i = 0; i < list.size(); ++i) {
+            const int row = list[i];
+            if (row < 0 || row >= size || seen.test(row) || (i > 0 && row <= list[i - 1])) {
+                qDebug() << "IVF sidecar is corrupt:" << path;
+                return false;
+            }
+            seen.set(row);
+        }
+        listed += list.size();
+    }
+    if (listed != size) {
+        qDebug() << "IVF sidecar is corrupt:" << path;
+        return false;
+    }
+
+    m_dim = dim;
+    m_size = size;
+    m_params.nprobe = nprobe;
+    m_params.nlist = lists.size();
+    m_centroids = centroids;
+    m_lists = lists;
+    return true;
+}
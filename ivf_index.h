@@ -0,0 +1,52 @@
+#ifndef IVF_INDEX_H
+#define IVF_INDEX_H
+
+#include "vector_index.h"
+
+class QThreadPool;
+
+struct IvfParams {
+    int nlist = 0;            // Number of inverted lists (0 = 4 * sqrt(rows))
+    int nprobe = 8;           // Default lists scanned per query
+    int iterations = 20;      // k-means iterations
+    int samplesPerList = 64;  // Training sample size = nlist * samplesPerList rows
+};
+
+// Inverted-file index: rows are bucketed by their nearest k-means centroid and a query
+// only scans the nprobe closest buckets. Memory overhead is one int per row plus the
+// centroids, so the footprint stays close to the raw vectors.
+class IvfIndex : public IVectorIndex {
+public:
+    explicit IvfIndex(const IvfParams& params = IvfParams());
+
+    QString name() const override { return "ivf"; }
+    int size() const override { return m_size; }
+    bool isTrained() const { return !m_centroids.isEmpty(); }
+    int listCount() const { return m_lists.size(); }
+    int dimension() const { return m_dim; }
+    const IvfParams& params() const { return m_params; }
+
+    static int recommendedLists(int rows);
+
+    // Spherical k-means over a dense sample (n x dim), sharded on the pool when given;
+    // drops any previous assignment
+    void train(const float* sample, int n, int dim, unsigned int seed = 42, QThreadPool* pool = nullptr);
+
+    void add(const VectorMatrix& matrix, int row) override;
+    void addRows(const VectorMatrix& matrix, int end, QThreadPool* pool); // add() for rows size()..end-1
+    void clear() override;
+    QVector<ScoredRow> search(const VectorMatrix& matrix, const float* query, const IndexQuery& params) const override;
+    std::unique_ptr<IVectorIndex> compacted(const VectorMatrix& matrix, const QVector<int>& remap) const override;
+
+    bool save(const QString& path) const override;
+    bool load(const QString& path) override;
+
+private:
+    IvfParams m_params;
+    int m_dim = 0;
+    int m_size = 0;
+    QVector<float> m_centroids;    // nlist x dim, unit length
+    QVector<QVector<int>> m_lists; // Row ordinals per list
+};
+
+#endif // IVF_INDEX_H
@@ -0,0 +1,106 @@
+#include "kmeans.h"
+#include "simd_kernels.h"
+#include <QThreadPool>
+#include <QtConcurrent>
+#include <random>
+#include <cstring>
+
+namespace KMeans {
+
+namespace {
+const int kShardRows = 1024;
+}
+
+int nearest(const float* centroids, int k, int dim, const float* v, bool spherical) {
+    int best = 0;
+    float bestScore = spherical ? -1e30f : 1e30f;
+    for (int c = 0; c < k; ++c) {
+        const float* centroid = centroids + (size_t)c * dim;
+        if (spherical) {
+            float s = SimdKernels::dot(v, centroid, dim);
+            if (s > bestScore) { bestScore = s; best = c; }
+        } else {
+            float d = SimdKernels::l2Squared(v, centroid, dim);
+            if (d < bestScore) { bestScore = d; best = c; }
+        }
+    }
+    return best;
+}
+
+int nearestAll(const float* centroids, int k, int dim, int n, const std::function<const float*(int)>& row, bool spherical,
+               int* out, QThreadPool* pool) {
+    auto assignRange = [&](int begin, int end) {
+        int changed = 0;
+        for (int i = begin; i < end; ++i) {
+            const int c = nearest(centroids, k, dim, row(i), spherical);
+            if (c != out[i]) {
+                out[i] = c;
+                changed++;
+            }
+        }
+        return changed;
+    };
+
+    const int shards = (n + kShardRows - 1) / kShardRows;
+    if (!pool || shards <= 1 || pool->maxThreadCount() < 2) return assignRange(0, n);
+    QVector<int> shardIndex(shards), changed(shards, 0);
+    for (int s = 0; s < shards; ++s) shardIndex[s] = s;
+    QtConcurrent::blockingMap(pool, shardIndex, [&](int s) {
+        changed[s] = assignRange(s * kShardRows, qMin(n, (s + 1) * kShardRows));
+    });
+    int total = 0;
+    for (int c : changed) total += c;
+    return total;
+}
+
+QVector<float> train(const float* data, int n, int dim, int k, int iterations, unsigned int seed, bool spherical,
+                     QThreadPool* pool) {
+    QVector<float> centroids;
+    if (n <= 0 || k <= 0 || dim <= 0) return centroids;
+    k = qMin(k, n);
+    centroids.resize(k * dim);
+
+    // Seed with k distinct sample rows (partial Fisher-Yates)
+    std::mt19937 rng(seed);
+    QVector<int> order(n);
+    for (int i = 0; i < n; ++i) order[i] = i;
+    for (int c = 0; c < k; ++c) {
+        int j = c + (int)(rng() % (unsigned int)(n - c));
+        std::swap(order[c], order[j]);
+        memcpy(centroids.data() + (size_t)c * dim, data + (size_t)order[c] * dim, dim * sizeof(float));
+    }
+
+    QVector<int> assign(n, -1);
+    QVector<double> sums(k * dim);
+    QVector<int> counts(k);
+
+    auto row = [data, dim](int i) { return data + (size_t)i * dim; };
+    for (int it = 0; it < iterations; ++it) {
+        int changed = nearestAll(centroids.constData(), k, dim, n, row, spherical, assign.data(), pool);
+        if (changed == 0 && it > 0) break;
+
+        sums.fill(0.0);
+        counts.fill(0);
+        for (int i = 0; i < n; ++i) {
+            const float* v = data + (size_t)i * dim;
+            double* sum = sums.data() + (size_t)assign[i] * dim;
+            for (int d = 0; d < dim; ++d) sum[d] += v[d];
+            counts[assign[i]]++;
+        }
+
+        for (int c = 0; c < k; ++c) {
+            float* centroid = centroids.data() + (size_t)c * dim;
+            if (counts[c] == 0) {
+                // Empty cluster: reseed from a random sample row
+                memcpy(centroid, data + (size_t)(rng() % (unsigned int)n) * dim, dim * sizeof(float));
+                continue;
+            }
+            const double* sum = sums.constData() + (size_t)c * dim;
+            for (int d = 0; d < dim; ++d) centroid[d] = (float)(sum[d] / counts[c]);
+            if (spherical) SimdKernels::normalize(centroid, dim);
+        }
+    }
+    return centroids;
+}
+
+} // namespace KMeans
@@ -0,0 +1,27 @@
+#ifndef KMEANS_H
+#define KMEANS_H
+
+#include <QVector>
+#include <functional>
+
+class QThreadPool;
+
+// Lloyd's k-means over a dense row-major block (n x dim, no padding).
+// Spherical mode maximizes dot product and keeps centroids unit length (for IVF on
+// normalized embeddings); otherwise plain squared-L2 (for PQ sub-spaces).
+namespace KMeans {
+
+// With a pool, each iteration's assignment step (the n x k x dim part) runs sharded on it;
+// rows are assigned independently, so the centroids are the same either way
+QVector<float> train(const float* data, int n, int dim, int k, int iterations, unsigned int seed, bool spherical,
+                     QThreadPool* pool = nullptr);
+
+int nearest(const float* centroids, int k, int dim, const float* v, bool spherical);
+
+// nearest() for rows 0..n-1 (row(i) gives each) into out; returns how many entries changed
+int nearestAll(const float* centroids, int k, int dim, int n, const std::function<const float*(int)>& row, bool spherical,
+               int* out, QThreadPool* pool);
+
+} // namespace KMeans
+
+#endif // KMEANS_H
@@ -36,7 +36,7 @@ MainWindow::MainWindow(QWidget *parent)
       m_rerankHealth(new QLabel("🔴 Reranking", this)) {
     
     m_showRankDiffCheck = new QCheckBox("Show Rank Diff (⬆️)", this);
-    m_mmrCheck = new QCheckBox("Adaptive MMR (Exp)", this);
+    m_mmrCheck = new QCheckBox("Adaptive MMR", this);
     m_explorationCheck = new QCheckBox("Exploration (Exp)", this);
     
     // ... UI Setup ...
@@ -122,6 +122,7 @@ MainWindow::MainWindow(QWidget *parent)
             m_store->close();
             m_store->setPath(dbName);
             m_store->init();
+            m_requestedHeadings.clear(); // Heading vectors live in the workspace database
             
             // Restore Engine Selections
             QString savedEmbed = m_store->getMetadata("embed_engine");
@@ -144,6 +145,7 @@ MainWindow::MainWindow(QWidget *parent)
             m_store->close();
             m_store->setPath(name);
             m_store->init();
+            m_requestedHeadings.clear();
             refreshWorkspaces();
             m_workspaceCombo->setCurrentText(name);
         }
@@ -190,7 +192,8 @@ MainWindow::MainWindow(QWidget *parent)
     m_rerankCheck->setChecked(false);
     
     QPushButton *searchBtn = new QPushButton("Search", this);
-    m_mmrCheck->setToolTip("Phase 4.1 diversity scheduling (Experimental)");
+    m_mmrCheck->setToolTip("Phase 4.1 diversity scheduling: drops near-duplicate chunks (embedding MMR)");
+    m_mmrCheck->setChecked(true);
     m_mmrCheck->setStyleSheet("color: #27ae60; font-weight: bold;");
 
     m_explorationCheck->setToolTip("Phase 4.3 Active signal acquisition (Experimental)");
@@ -454,6 +457,7 @@ MainWindow::MainWindow(QWidget *parent)
             m_totalChunks = 0;
             m_processedChunks = 0;
             m_chunkQueue.clear();
+            m_requestedHeadings.clear();
             
             m_pdfProcessor->extractChunksAsync(fileName);
         }
@@ -462,6 +466,7 @@ MainWindow::MainWindow(QWidget *parent)
     connect(clearBtn, &QPushButton::clicked, [this, resultsTable, progressBar]() {
         if (QMessageBox::question(this, "Clear Index", "Delete all indexed chunks from the database?") == QMessageBox::Yes) {
             m_store->clear();
+            m_requestedHeadings.clear();
             resultsTable->setRowCount(0);
             progressBar->setValue(0);
             m_statusLabel->setText("Database cleared. Indexing required.");
@@ -492,6 +497,10 @@ MainWindow::MainWindow(QWidget *parent)
     });
 
     connect(m_api, &GeminiApi::errorOccurred, this, &MainWindow::handleError);
+    connect(m_api, &GeminiApi::embeddingFailed, this, [this](const QString&, const QMap<QString, QVariant>& metadata) {
+        // A heading whose request failed is asked for again the next time a chunk needs it
+        if (metadata.contains("heading_vec")) m_requestedHeadings.remove(metadata.value("heading_vec").toString());
+    });
     connect(m_api, &GeminiApi::summaryReady, this, &MainWindow::handleSummaryReady);
     connect(m_api, &GeminiApi::synthesisReady, this, &MainWindow::handleSynthesisReady);
     
@@ -569,6 +578,10 @@ MainWindow::MainWindow(QWidget *parent)
                 m_tRerank = 0;
                 updateResultsTable(results, "Complete");
             }
+        } else if (metadata.contains("heading_vec")) {
+            // INDEXING MODE: section heading embedded ahead of its first chunk
+            m_store->setHeadingVector(metadata.value("heading_vec").toString(), embedding);
+            processNextChunk(progressBar);
         } else {
             // INDEXING MODE
             int pageNum = metadata.value("page").toInt();
@@ -747,6 +760,17 @@ void MainWindow::processNextChunk(QProgressBar* progressBar) {
         return;
     }
 
+    // Embed each section heading once, before the first chunk that needs it
+    if (!next.headingPath.isEmpty() && !m_requestedHeadings.contains(next.headingPath)
+        && !m_store->hasHeadingVector(next.headingPath)) {
+        m_requestedHeadings.insert(next.headingPath);
+        m_chunkQueue.prepend(next);
+        QMap<QString, QVariant> headingMeta;
+        headingMeta["heading_vec"] = next.headingPath;
+        m_api->getEmbeddings(next.headingPath, headingMeta);
+        return;
+    }
+
     QMap<QString, QVariant> metadata;
     metadata["page"] = next.pageNum;
     metadata["index"] = m_processedChunks;
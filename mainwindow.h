@@ -5,6 +5,7 @@
 #include <QString>
 #include <QVector>
 #include <QStringList>
+#include <QSet>
 #include "gemini_api.h"
 #include "pdf_processor.h"
 
@@ -70,6 +71,7 @@ private:
     bool m_isIndexing = false;
     bool m_extractionComplete = false;
     QVector<Chunk> m_chunkQueue;
+    QSet<QString> m_requestedHeadings; // Heading paths sent for embedding (one request each)
     int m_totalChunks = 0;
     int m_processedChunks = 0;
     
@@ -0,0 +1,72 @@
+#include "mmr_selector.h"
+#include "simd_kernels.h"
+
+QVector<int> MmrSelector::select(const QVector<Candidate>& candidates, int dim, int k, QVector<float>* penalties) const {
+    const int n = candidates.size();
+    k = qMin(k, n);
+    QVector<int> picks;
+    if (k <= 0) return picks;
+    picks.reserve(k);
+    if (penalties) penalties->clear();
+
+    int groups = 0, sections = 0;
+    for (const Candidate& c : candidates) {
+        groups = qMax(groups, c.group + 1);
+        sections = qMax(sections, c.section + 1);
+    }
+    QVector<char> groupTaken(groups, 0);
+    QVector<char> sectionTaken(sections, 0);
+    QVector<float> maxSim(n, 0.0f); // Negative similarity earns no bonus
+
+    QVector<int> remaining(n);
+    for (int i = 0; i < n; ++i) remaining[i] = i;
+    QVector<const float*> block(4);
+    QVector<int> blockIdx(4);
+    float blockSims[4];
+
+    while (picks.size() < k) {
+        int best = -1;
+        float bestScore = 0.0f, bestPenalty = 0.0f;
+        for (int r = 0; r < remaining.size(); ++r) {
+            const Candidate& c = candidates[remaining[r]];
+            float penalty = maxSim[remaining[r]];
+            if (c.group >= 0 && groupTaken[c.group]) penalty += groupPenalty;
+            if (c.section >= 0 && sectionTaken[c.section]) penalty += sectionPenalty;
+            const float score = lambda * c.relevance - (1.0f - lambda) * penalty;
+            if (best < 0 || score > bestScore) { // Ties keep the earlier (better fused) candidate
+                best = r;
+                bestScore = score;
+                bestPenalty = penalty;
+            }
+        }
+
+        const int pick = remaining[best];
+        remaining.removeAt(best); // Order-preserving, so the tie rule above stays stable
+        picks.append(pick);
+        if (penalties) penalties->append(bestPenalty);
+        const Candidate& p = candidates[pick];
+        if (p.group >= 0) groupTaken[p.group] = 1;
+        if (p.section >= 0) sectionTaken[p.section] = 1;
+        if (!p.vector || picks.size() == k) continue;
+
+        // Similarity of every remaining candidate to the new pick, four rows per kernel call
+        int filled = 0;
+        auto flush = [&]() {
+            if (filled == 4) {
+                SimdKernels::dot4(p.vector, block.constData(), dim, blockSims);
+            } else {
+                for (int j = 0; j < filled; ++j) blockSims[j] = SimdKernels::dot(p.vector, block[j], dim);
+            }
+            for (int j = 0; j < filled; ++j) maxSim[blockIdx[j]] = qMax(maxSim[blockIdx[j]], blockSims[j]);
+            filled = 0;
+        };
+        for (int idx : remaining) {
+            if (!candidates[idx].vector) continue;
+            block[filled] = candidates[idx].vector;
+            blockIdx[filled] = idx;
+            if (++filled == 4) flush();
+        }
+        if (filled > 0) flush();
+    }
+    return picks;
+}
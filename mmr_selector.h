@@ -0,0 +1,28 @@
+#ifndef MMR_SELECTOR_H
+#define MMR_SELECTOR_H
+
+#include <QVector>
+
+// Greedy maximal marginal relevance. Each pick maximizes
+//   lambda * relevance - (1 - lambda) * (max similarity to the picks so far + structural penalty)
+// Every candidate keeps its max similarity to the picks; after a pick only the new pick is
+// scored against the remaining candidates, in blocks of four (SimdKernels::dot4). A pick
+// costs O(n * dim) for that update plus a flat argmax, with no hashing in the loop.
+class MmrSelector {
+public:
+    struct Candidate {
+        float relevance;     // Normalized to [0, 1] by the caller
+        const float* vector; // Unit length (resident matrix row); nullptr = structural terms only
+        int group;           // Document key, -1 = none
+        int section;         // Heading slot, -1 = none
+    };
+
+    float lambda = 0.5f;
+    float groupPenalty = 0.15f;  // Once a pick shares the candidate's document
+    float sectionPenalty = 0.1f; // Once a pick shares its section
+
+    // Candidate indexes in pick order; `penalties` receives each pick's redundancy term
+    QVector<int> select(const QVector<Candidate>& candidates, int dim, int k, QVector<float>* penalties = nullptr) const;
+};
+
+#endif // MMR_SELECTOR_H
@@ -0,0 +1,105 @@
+#include "pca_projection.h"
+#include "simd_kernels.h"
+#include <QDataStream>
+#include <QIODevice>
+#include <QDebug>
+#include <random>
+
+namespace {
+
+const quint32 kPcaMagic = 0x50434131; // "PCA1"
+
+// Modified Gram-Schmidt over k rows of length dim; degenerate rows are re-randomized
+void orthonormalize(float* rows, int k, int dim, std::mt19937& rng) {
+    std::normal_distribution<float> gauss;
+    for (int c = 0; c < k; ++c) {
+        float* row = rows + (size_t)c * dim;
+        for (int attempt = 0; attempt < 3; ++attempt) {
+            for (int p = 0; p < c; ++p) {
+                const float* prev = rows + (size_t)p * dim;
+                float proj = SimdKernels::dot(row, prev, dim);
+                for (int i = 0; i < dim; ++i) row[i] -= proj * prev[i];
+            }
+            if (SimdKernels::normalize(row, dim) > 1e-6f) break;
+            for (int i = 0; i < dim; ++i) row[i] = gauss(rng);
+        }
+    }
+}
+
+} // namespace
+
+double PcaProjection::train(const float* sample, int n, int dim, int components, int iterations, unsigned int seed) {
+    m_basis.clear();
+    if (n <= 0 || dim <= 0 || components <= 0) return 0.0;
+    const int k = qMin(components, dim);
+
+    std::mt19937 rng(seed);
+    std::normal_distribution<float> gauss;
+    QVector<float> basis(k * dim);
+    for (float& v : basis) v = gauss(rng);
+    orthonormalize(basis.data(), k, dim, rng);
+
+    // Subspace iteration: basis <- orth(X^T X basis), converging on the top-k right singular vectors
+    QVector<float> coords(n * k);
+    for (int it = 0; it < iterations; ++it) {
+        for (int i = 0; i < n; ++i) {
+            const float* x = sample + (size_t)i * dim;
+            for (int c = 0; c < k; ++c) coords[i * k + c] = SimdKernels::dot(x, basis.constData() + (size_t)c * dim, dim);
+        }
+        basis.fill(0.0f);
+        for (int i = 0; i < n; ++i) {
+            const float* x = sample + (size_t)i * dim;
+            for (int c = 0; c < k; ++c) {
+                float w = coords[i * k + c];
+                float* row = basis.data() + (size_t)c * dim;
+                for (int d = 0; d < dim; ++d) row[d] += w * x[d];
+            }
+        }
+        orthonormalize(basis.data(), k, dim, rng);
+    }
+
+    double captured = 0.0, total = 0.0;
+    for (int i = 0; i < n; ++i) {
+        const float* x = sample + (size_t)i * dim;
+        total += SimdKernels::dot(x, x, dim);
+        for (int c = 0; c < k; ++c) {
+            float p = SimdKernels::dot(x, basis.constData() + (size_t)c * dim, dim);
+            captured += p * p;
+        }
+    }
+
+    m_inDim = dim;
+    m_outDim = k;
+    m_basis = basis;
+    return total > 0.0 ? captured / total : 0.0;
+}
+
+void PcaProjection::project(const float* in, float* out) const {
+    for (int c = 0; c < m_outDim; ++c) out[c] = SimdKernels::dot(in, m_basis.constData() + (size_t)c * m_inDim, m_inDim);
+}
+
+QByteArray PcaProjection::serialize() const {
+    QByteArray data;
+    QDataStream out(&data, QIODevice::WriteOnly);
+    out.setVersion(QDataStream::Qt_6_0);
+    out << kPcaMagic << (qint32)m_inDim << (qint32)m_outDim << m_basis;
+    return data;
+}
+
+bool PcaProjection::deserialize(const QByteArray& data) {
+    QDataStream in(data);
+    in.setVersion(QDataStream::Qt_6_0);
+    quint32 magic = 0;
+    qint32 inDim = 0, outDim = 0;
+    QVector<float> basis;
+    in >> magic >> inDim >> outDim >> basis;
+    if (in.status() != QDataStream::Ok || magic != kPcaMagic || inDim <= 0 || outDim <= 0
+        || basis.size() != inDim * outDim) {
+        qDebug() << "PCA projection is corrupt or from an unknown format";
+        return false;
+    }
+    m_inDim = inDim;
+    m_outDim = outDim;
+    m_basis = basis;
+    return true;
+}
@@ -0,0 +1,32 @@
+#ifndef PCA_PROJECTION_H
+#define PCA_PROJECTION_H
+
+#include <QVector>
+#include <QByteArray>
+
+// Linear projection onto the top principal subspace of the stored embeddings.
+// Trained by randomized subspace iteration over a sample (no dim x dim covariance), uncentered
+// so that dot(project(q), project(x)) approximates dot(q, x) directly. Any orthonormal basis
+// of the subspace gives the same reduced dot products, so no eigen-rotation is needed.
+class PcaProjection {
+public:
+    bool isTrained() const { return !m_basis.isEmpty(); }
+    int inputDimension() const { return m_inDim; }
+    int outputDimension() const { return m_outDim; }
+
+    // Returns the fraction of the sample's energy captured by the subspace (0 on failure)
+    double train(const float* sample, int n, int dim, int components, int iterations = 4, unsigned int seed = 42);
+
+    // out must hold outputDimension() floats
+    void project(const float* in, float* out) const;
+
+    QByteArray serialize() const;
+    bool deserialize(const QByteArray& data);
+
+private:
+    int m_inDim = 0;
+    int m_outDim = 0;
+    QVector<float> m_basis; // outDim x inDim, orthonormal rows
+};
+
+#endif // PCA_PROJECTION_H
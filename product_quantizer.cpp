@@ -0,0 +1,87 @@
+#include "product_quantizer.h"
+#include "kmeans.h"
+#include "simd_kernels.h"
+#include <QDataStream>
+#include <QIODevice>
+#include <QDebug>
+#include <cstring>
+
+namespace {
+const quint32 kPqMagic = 0x50513031; // "PQ01"
+}
+
+int ProductQuantizer::fitSubspaces(int dim, int requested) {
+    for (int m = qMin(requested, dim); m > 1; --m) {
+        if (dim % m == 0) return m;
+    }
+    return 1;
+}
+
+void ProductQuantizer::train(const float* sample, int n, int dim, int subspaces, int iterations, unsigned int seed) {
+    m_codebooks.clear();
+    if (n <= 0 || dim <= 0) return;
+
+    m_dim = dim;
+    m_subspaces = fitSubspaces(dim, subspaces);
+    m_subDim = dim / m_subspaces;
+    m_codebooks.resize(m_subspaces * kCentroids * m_subDim);
+
+    QVector<float> slice(n * m_subDim);
+    for (int s = 0; s < m_subspaces; ++s) {
+        for (int i = 0; i < n; ++i) {
+            memcpy(slice.data() + (size_t)i * m_subDim, sample + (size_t)i * dim + s * m_subDim, m_subDim * sizeof(float));
+        }
+        QVector<float> centroids = KMeans::train(slice.constData(), n, m_subDim, kCentroids, iterations, seed + s, false);
+        int trained = centroids.size() / m_subDim;
+
+        // Fewer samples than centroids: repeat the trained ones so every code byte is valid
+        float* book = m_codebooks.data() + (size_t)s * kCentroids * m_subDim;
+        for (int c = 0; c < kCentroids; ++c) {
+            memcpy(book + (size_t)c * m_subDim, centroids.constData() + (size_t)(c % trained) * m_subDim, m_subDim * sizeof(float));
+        }
+    }
+}
+
+void ProductQuantizer::encode(const float* vec, uchar* code) const {
+    for (int s = 0; s < m_subspaces; ++s) {
+        const float* book = m_codebooks.constData() + (size_t)s * kCentroids * m_subDim;
+        code[s] = (uchar)KMeans::nearest(book, kCentroids, m_subDim, vec + s * m_subDim, false);
+    }
+}
+
+void ProductQuantizer::computeTable(const float* query, float* table) const {
+    for (int s = 0; s < m_subspaces; ++s) {
+        const float* book = m_codebooks.constData() + (size_t)s * kCentroids * m_subDim;
+        const float* sub = query + s * m_subDim;
+        for (int c = 0; c < kCentroids; ++c) {
+            table[s * kCentroids + c] = SimdKernels::dot(sub, book + (size_t)c * m_subDim, m_subDim);
+        }
+    }
+}
+
+QByteArray ProductQuantizer::serialize() const {
+    QByteArray data;
+    QDataStream out(&data, QIODevice::WriteOnly);
+    out.setVersion(QDataStream::Qt_6_0);
+    out << kPqMagic << (qint32)m_dim << (qint32)m_subspaces << m_codebooks;
+    return data;
+}
+
+bool ProductQuantizer::deserialize(const QByteArray& data) {
+    QDataStream in(data);
+    in.setVersion(QDataStream::Qt_6_0);
+    quint32 magic = 0;
+    qint32 dim = 0, subspaces = 0;
+    QVector<float> codebooks;
+    in >> magic >> dim >> subspaces >> codebooks;
+    if (in.status() != QDataStream::Ok || magic != kPqMagic || dim <= 0 || subspaces <= 0
+        || dim % subspaces != 0 || codebooks.size() != dim * kCentroids) {
+        qDebug() << "PQ codebook is corrupt or from an unknown format";
+        return false;
+    }
+    m_dim = dim;
+    m_subspaces = subspaces;
+    m_subDim = dim / subspaces;
+    m_codebooks = codebooks;
+    return true;
+}
@@ -0,0 +1,52 @@
+#ifndef PRODUCT_QUANTIZER_H
+#define PRODUCT_QUANTIZER_H
+
+#include <QVector>
+#include <QByteArray>
+
+// Product quantization codec: a vector is split into M contiguous sub-vectors and each is
+// replaced by the index of its nearest of 256 sub-centroids, so a 3072-dim float vector
+// (12 KB) becomes M bytes. Queries are scored with asymmetric distance computation: one
+// M x 256 table of query/sub-centroid dot products, then M lookups per code.
+class ProductQuantizer {
+public:
+    static const int kCentroids = 256;
+
+    bool isTrained() const { return !m_codebooks.isEmpty(); }
+    int dimension() const { return m_dim; }
+    int subspaces() const { return m_subspaces; }
+    int codeSize() const { return m_subspaces; } // One byte per subspace
+
+    // Largest subspace count <= requested that divides dim evenly
+    static int fitSubspaces(int dim, int requested);
+
+    // Independent (L2) k-means per subspace over a dense sample (n x dim)
+    void train(const float* sample, int n, int dim, int subspaces, int iterations, unsigned int seed = 42);
+    void encode(const float* vec, uchar* code) const;
+
+    // table must hold codeSize() * kCentroids floats
+    void computeTable(const float* query, float* table) const;
+    static inline float score(const float* table, const uchar* code, int subspaces) {
+        float s0 = 0.0f, s1 = 0.0f, s2 = 0.0f, s3 = 0.0f;
+        int s = 0;
+        for (; s + 4 <= subspaces; s += 4, table += 4 * kCentroids) {
+            s0 += table[code[s]];
+            s1 += table[kCentroids + code[s + 1]];
+            s2 += table[2 * kCentroids + code[s + 2]];
+            s3 += table[3 * kCentroids + code[s + 3]];
+        }
+        for (; s < subspaces; ++s, table += kCentroids) s0 += table[code[s]];
+        return (s0 + s1) + (s2 + s3);
+    }
+
+    QByteArray serialize() const;
+    bool deserialize(const QByteArray& data);
+
+private:
+    int m_dim = 0;
+    int m_subspaces = 0;
+    int m_subDim = 0;
+    QVector<float> m_codebooks; // subspaces x kCentroids x subDim
+};
+
+#endif // PRODUCT_QUANTIZER_H
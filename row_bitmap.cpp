@@ -0,0 +1,50 @@
+#include "row_bitmap.h"
+
+RowBitmap::RowBitmap(int rows, bool value) {
+    resize(rows);
+    if (value) fill(true);
+}
+
+void RowBitmap::resize(int rows) {
+    m_rows = qMax(0, rows);
+    m_words.resize((m_rows + 63) / 64); // QVector value-initializes the new words
+    clearTail();
+}
+
+void RowBitmap::fill(bool value) {
+    m_words.fill(value ? ~0ULL : 0ULL);
+    clearTail();
+}
+
+void RowBitmap::set(int r) {
+    if (r < 0) return;
+    if (r >= m_rows) resize(r + 1);
+    m_words[r >> 6] |= 1ULL << (r & 63);
+}
+
+int RowBitmap::count() const {
+    int total = 0;
+    for (uint64_t w : m_words) total += qPopulationCount(w);
+    return total;
+}
+
+void RowBitmap::unite(const RowBitmap& other) {
+    if (other.m_rows > m_rows) resize(other.m_rows);
+    for (int w = 0; w < other.m_words.size(); ++w) m_words[w] |= other.m_words[w];
+}
+
+void RowBitmap::intersect(const RowBitmap& other) {
+    const int shared = qMin(m_words.size(), other.m_words.size());
+    for (int w = 0; w < shared; ++w) m_words[w] &= other.m_words[w];
+    for (int w = shared; w < m_words.size(); ++w) m_words[w] = 0;
+}
+
+void RowBitmap::subtract(const RowBitmap& other) {
+    const int shared = qMin(m_words.size(), other.m_words.size());
+    for (int w = 0; w < shared; ++w) m_words[w] &= ~other.m_words[w];
+}
+
+void RowBitmap::clearTail() {
+    // Keeps count() exact and lets resize() grow without stale bits
+    if (m_rows & 63) m_words.last() &= ~0ULL >> (64 - (m_rows & 63));
+}
@@ -0,0 +1,50 @@
+#ifndef ROW_BITMAP_H
+#define ROW_BITMAP_H
+
+#include <QVector>
+#include <QtAlgorithms>
+#include <cstdint>
+
+// Dense bitset over resident-matrix row ordinals. Used as a posting list per doc_id /
+// chunk_type and as the compiled allow-list of a filtered search, so combining
+// predicates is a word-wise AND/OR and a scan can skip 64 rejected rows per zero word.
+class RowBitmap {
+public:
+    explicit RowBitmap(int rows = 0, bool value = false);
+
+    int rows() const { return m_rows; }
+    void resize(int rows); // New rows are cleared
+    void fill(bool value);
+
+    void set(int r); // Grows the bitmap to cover r
+    bool test(int r) const { return r >= 0 && r < m_rows && (m_words[r >> 6] >> (r & 63)) & 1; }
+    int count() const;
+
+    // Bits past the end of the shorter bitmap count as clear
+    void unite(const RowBitmap& other);
+    void intersect(const RowBitmap& other);
+    void subtract(const RowBitmap& other); // this AND NOT other
+
+    // Calls fn(row) for every set row in [begin, end), in ascending order
+    template <typename Fn>
+    void forEach(int begin, int end, const Fn& fn) const {
+        end = qMin(end, m_rows);
+        for (int w = begin >> 6; begin < end && w <= (end - 1) >> 6; ++w) {
+            uint64_t bits = m_words[w];
+            if (w == begin >> 6) bits &= ~0ULL << (begin & 63);
+            if (w == (end - 1) >> 6 && (end & 63)) bits &= ~0ULL >> (64 - (end & 63));
+            while (bits) {
+                fn((w << 6) + qCountTrailingZeroBits(bits));
+                bits &= bits - 1;
+            }
+        }
+    }
+
+private:
+    void clearTail();
+
+    int m_rows = 0;
+    QVector<uint64_t> m_words;
+};
+
+#endif // ROW_BITMAP_H
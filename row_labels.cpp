@@ -0,0 +1,34 @@
+#include "row_labels.h"
+
+void RowLabels::clear() {
+    doc.clear();
+    type.clear();
+    heading.clear();
+    level.clear();
+    for (int k = 0; k < KindCount; ++k) {
+        names[k].clear();
+        m_ordinals[k].clear();
+    }
+}
+
+void RowLabels::append(const QString& docId, const QString& chunkType, const QString& headingPath, int headingLevel) {
+    doc.append(intern(Doc, docId));
+    type.append(intern(Type, chunkType));
+    heading.append(intern(Heading, headingPath));
+    level.append(headingLevel);
+}
+
+void RowLabels::appendNone() {
+    doc.append(-1);
+    type.append(-1);
+    heading.append(-1);
+    level.append(0);
+}
+
+int RowLabels::intern(Kind kind, const QString& name) {
+    auto it = m_ordinals[kind].constFind(name);
+    if (it != m_ordinals[kind].constEnd()) return it.value();
+    names[kind] << name;
+    m_ordinals[kind].insert(name, names[kind].size() - 1);
+    return names[kind].size() - 1;
+}
@@ -0,0 +1,35 @@
+#ifndef ROW_LABELS_H
+#define ROW_LABELS_H
+
+#include <QString>
+#include <QStringList>
+#include <QHash>
+#include <QVector>
+
+// Per-row labels of the resident matrix, the inverse of the posting bitmaps: a row's doc id,
+// chunk type and heading path are ordinals into interned name tables, so the per-candidate
+// lookups of a query (intent boost, MMR groups) are one array read each. Name tables are
+// append-only; an ordinal never changes once handed out.
+struct RowLabels {
+    enum Kind { Doc, Type, Heading, KindCount };
+
+    QVector<int> doc;     // Into names[Doc]; -1 for a deleted row's placeholder
+    QVector<int> type;    // Into names[Type]
+    QVector<int> heading; // Into names[Heading]
+    QVector<int> level;
+    QStringList names[KindCount];
+
+    int size() const { return doc.size(); }
+    void clear();
+    void append(const QString& docId, const QString& chunkType, const QString& headingPath, int headingLevel);
+    void appendNone();
+    int intern(Kind kind, const QString& name);
+
+    QString name(Kind kind, int ordinal) const { return ordinal >= 0 && ordinal < names[kind].size() ? names[kind][ordinal] : QString(); }
+    QString typeOf(int row) const { return name(Type, type.value(row, -1)); }
+
+private:
+    QHash<QString, int> m_ordinals[KindCount];
+};
+
+#endif // ROW_LABELS_H
@@ -0,0 +1,651 @@
+#include "simd_kernels.h"
+#include <cmath>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define SIMD_KERNELS_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+// MSVC exposes every intrinsic unconditionally; GCC/Clang need per-function targets
+#if defined(SIMD_KERNELS_X86) && !defined(_MSC_VER)
+#define TARGET_AVX2 __attribute__((target("avx2,fma")))
+#define TARGET_AVX512 __attribute__((target("avx512f")))
+#define TARGET_POPCNT __attribute__((target("popcnt")))
+#define TARGET_F16C __attribute__((target("avx2,f16c")))
+#else
+#define TARGET_AVX2
+#define TARGET_AVX512
+#define TARGET_POPCNT
+#define TARGET_F16C
+#endif
+
+namespace SimdKernels {
+
+namespace {
+
+struct KernelTable {
+    Level level;
+    float (*dot)(const float*, const float*, int);
+    float (*l2)(const float*, const float*, int);
+    void (*cosineParts)(const float*, const float*, int, float&, float&, float&); // dot, |a|^2, |b|^2
+    void (*dot4)(const float*, const float* const*, int, float*);
+    int32_t (*dotInt8)(const int8_t*, const int8_t*, int);
+    int (*hamming)(const uint64_t*, const uint64_t*, int);
+    void (*halfToFloat)(const uint16_t*, float*, int);
+    void (*floatToHalf)(const float*, uint16_t*, int);
+    void (*bf16ToFloat)(const uint16_t*, float*, int);
+};
+
+inline float cosineFrom(float d, float na, float nb) {
+    if (na <= 0.0f || nb <= 0.0f) return 0.0f;
+    return d / (std::sqrt(na) * std::sqrt(nb));
+}
+
+// --- Portable half-precision conversions ---
+
+float halfBitsToFloat(uint16_t h) {
+    uint32_t sign = (uint32_t)(h & 0x8000) << 16;
+    uint32_t exp = (h >> 10) & 0x1F;
+    uint32_t mant = h & 0x3FF;
+    uint32_t bits;
+    if (exp == 0) {
+        if (mant == 0) {
+            bits = sign;
+        } else { // Subnormal: renormalize into a float exponent
+            exp = 113;
+            while (!(mant & 0x400)) { mant <<= 1; exp--; }
+            bits = sign | (exp << 23) | ((mant & 0x3FF) << 13);
+        }
+    } else if (exp == 31) {
+        bits = sign | 0x7F800000 | (mant << 13);
+    } else {
+        bits = sign | ((exp + 112) << 23) | (mant << 13);
+    }
+    float f;
+    memcpy(&f, &bits, sizeof(f));
+    return f;
+}
+
+uint16_t floatToHalfBits(float f) {
+    uint32_t x;
+    memcpy(&x, &f, sizeof(x));
+    uint16_t sign = (uint16_t)((x >> 16) & 0x8000);
+    uint32_t absx = x & 0x7FFFFFFF;
+    if (absx >= 0x7F800000) return sign | (absx > 0x7F800000 ? 0x7E00 : 0x7C00); // NaN / Inf
+    if (absx >= 0x477FF000) return sign | 0x7C00;                                // Rounds past 65504
+    if (absx < 0x38800000) {                                                     // Half subnormal range
+        if (absx < 0x33000000) return sign;
+        uint32_t mant = (absx & 0x7FFFFF) | 0x800000;
+        int shift = 126 - (int)(absx >> 23);
+        uint32_t h = mant >> shift;
+        uint32_t rem = mant & ((1u << shift) - 1), halfway = 1u << (shift - 1);
+        if (rem > halfway || (rem == halfway && (h & 1))) h++;
+        return sign | (uint16_t)h;
+    }
+    uint32_t h = (absx - 0x38000000) >> 13; // Rebias 127 -> 15
+    uint32_t rem = absx & 0x1FFF;
+    if (rem > 0x1000 || (rem == 0x1000 && (h & 1))) h++; // A carry into the exponent is still correct
+    return sign | (uint16_t)h;
+}
+
+void halfToFloatScalar(const uint16_t* in, float* out, int n) {
+    for (int i = 0; i < n; ++i) out[i] = halfBitsToFloat(in[i]);
+}
+
+void floatToHalfScalar(const float* in, uint16_t* out, int n) {
+    for (int i = 0; i < n; ++i) out[i] = floatToHalfBits(in[i]);
+}
+
+void bf16ToFloatScalar(const uint16_t* in, float* out, int n) {
+    for (int i = 0; i < n; ++i) {
+        uint32_t bits = (uint32_t)in[i] << 16;
+        memcpy(out + i, &bits, sizeof(float));
+    }
+}
+
+// Portable SWAR popcount for CPUs without POPCNT (and non-x86 builds)
+int hammingSwar(const uint64_t* a, const uint64_t* b, int words) {
+    int s = 0;
+    for (int i = 0; i < words; ++i) {
+        uint64_t x = a[i] ^ b[i];
+        x = x - ((x >> 1) & 0x5555555555555555ULL);
+        x = (x & 0x3333333333333333ULL) + ((x >> 2) & 0x3333333333333333ULL);
+        x = (x + (x >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+        s += (int)((x * 0x0101010101010101ULL) >> 56);
+    }
+    return s;
+}
+
+#ifndef SIMD_KERNELS_X86
+
+// --- Scalar reference (non-x86 builds) ---
+
+float dotScalar(const float* a, const float* b, int n) {
+    float s = 0.0f;
+    for (int i = 0; i < n; ++i) s += a[i] * b[i];
+    return s;
+}
+
+float l2Scalar(const float* a, const float* b, int n) {
+    float s = 0.0f;
+    for (int i = 0; i < n; ++i) { float d = a[i] - b[i]; s += d * d; }
+    return s;
+}
+
+void cosineScalar(const float* a, const float* b, int n, float& d, float& na, float& nb) {
+    d = na = nb = 0.0f;
+    for (int i = 0; i < n; ++i) {
+        d += a[i] * b[i];
+        na += a[i] * a[i];
+        nb += b[i] * b[i];
+    }
+}
+
+void dot4Scalar(const float* a, const float* const* b, int n, float* out) {
+    for (int j = 0; j < 4; ++j) out[j] = dotScalar(a, b[j], n);
+}
+
+int32_t dotInt8Scalar(const int8_t* a, const int8_t* b, int n) {
+    int32_t s = 0;
+    for (int i = 0; i < n; ++i) s += (int32_t)a[i] * b[i];
+    return s;
+}
+
+template <int N>
+float fixedScalar(const float* a, const float* b, int) {
+    return dotScalar(a, b, N);
+}
+
+#else
+
+// --- SSE2 baseline (always available on x64) ---
+
+inline float hsum128(__m128 v) {
+    __m128 shuf = _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1));
+    __m128 sums = _mm_add_ps(v, shuf);
+    shuf = _mm_movehl_ps(shuf, sums);
+    sums = _mm_add_ss(sums, shuf);
+    return _mm_cvtss_f32(sums);
+}
+
+float dotSse2(const float* a, const float* b, int n) {
+    __m128 acc0 = _mm_setzero_ps(), acc1 = _mm_setzero_ps();
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+        acc1 = _mm_add_ps(acc1, _mm_mul_ps(_mm_loadu_ps(a + i + 4), _mm_loadu_ps(b + i + 4)));
+    }
+    float s = hsum128(_mm_add_ps(acc0, acc1));
+    for (; i < n; ++i) s += a[i] * b[i];
+    return s;
+}
+
+float l2Sse2(const float* a, const float* b, int n) {
+    __m128 acc = _mm_setzero_ps();
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128 d = _mm_sub_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i));
+        acc = _mm_add_ps(acc, _mm_mul_ps(d, d));
+    }
+    float s = hsum128(acc);
+    for (; i < n; ++i) { float d = a[i] - b[i]; s += d * d; }
+    return s;
+}
+
+void cosineSse2(const float* a, const float* b, int n, float& d, float& na, float& nb) {
+    __m128 accD = _mm_setzero_ps(), accA = _mm_setzero_ps(), accB = _mm_setzero_ps();
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128 va = _mm_loadu_ps(a + i), vb = _mm_loadu_ps(b + i);
+        accD = _mm_add_ps(accD, _mm_mul_ps(va, vb));
+        accA = _mm_add_ps(accA, _mm_mul_ps(va, va));
+        accB = _mm_add_ps(accB, _mm_mul_ps(vb, vb));
+    }
+    d = hsum128(accD); na = hsum128(accA); nb = hsum128(accB);
+    for (; i < n; ++i) { d += a[i] * b[i]; na += a[i] * a[i]; nb += b[i] * b[i]; }
+}
+
+void dot4Sse2(const float* a, const float* const* b, int n, float* out) {
+    __m128 acc0 = _mm_setzero_ps(), acc1 = _mm_setzero_ps(), acc2 = _mm_setzero_ps(), acc3 = _mm_setzero_ps();
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128 va = _mm_loadu_ps(a + i);
+        acc0 = _mm_add_ps(acc0, _mm_mul_ps(va, _mm_loadu_ps(b[0] + i)));
+        acc1 = _mm_add_ps(acc1, _mm_mul_ps(va, _mm_loadu_ps(b[1] + i)));
+        acc2 = _mm_add_ps(acc2, _mm_mul_ps(va, _mm_loadu_ps(b[2] + i)));
+        acc3 = _mm_add_ps(acc3, _mm_mul_ps(va, _mm_loadu_ps(b[3] + i)));
+    }
+    out[0] = hsum128(acc0); out[1] = hsum128(acc1); out[2] = hsum128(acc2); out[3] = hsum128(acc3);
+    for (; i < n; ++i) {
+        for (int j = 0; j < 4; ++j) out[j] += a[i] * b[j][i];
+    }
+}
+
+inline int32_t hsum128i(__m128i v) {
+    v = _mm_add_epi32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2)));
+    v = _mm_add_epi32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtsi128_si32(v);
+}
+
+int32_t dotInt8Sse2(const int8_t* a, const int8_t* b, int n) {
+    // No byte multiply before SSSE3: sign-extend to int16 and use pmaddwd
+    const __m128i zero = _mm_setzero_si128();
+    __m128i acc = _mm_setzero_si128();
+    int i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+        __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i));
+        __m128i sa = _mm_cmpgt_epi8(zero, va), sb = _mm_cmpgt_epi8(zero, vb);
+        acc = _mm_add_epi32(acc, _mm_madd_epi16(_mm_unpacklo_epi8(va, sa), _mm_unpacklo_epi8(vb, sb)));
+        acc = _mm_add_epi32(acc, _mm_madd_epi16(_mm_unpackhi_epi8(va, sa), _mm_unpackhi_epi8(vb, sb)));
+    }
+    int32_t s = hsum128i(acc);
+    for (; i < n; ++i) s += (int32_t)a[i] * b[i];
+    return s;
+}
+
+// --- AVX2 + FMA ---
+
+TARGET_AVX2 inline float hsum256(__m256 v) {
+    return hsum128(_mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1)));
+}
+
+TARGET_AVX2 float dotAvx2(const float* a, const float* b, int n) {
+    __m256 acc0 = _mm256_setzero_ps(), acc1 = _mm256_setzero_ps();
+    __m256 acc2 = _mm256_setzero_ps(), acc3 = _mm256_setzero_ps();
+    int i = 0;
+    for (; i + 32 <= n; i += 32) {
+        acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i), acc0);
+        acc1 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i + 8), _mm256_loadu_ps(b + i + 8), acc1);
+        acc2 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i + 16), _mm256_loadu_ps(b + i + 16), acc2);
+        acc3 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i + 24), _mm256_loadu_ps(b + i + 24), acc3);
+    }
+    for (; i + 8 <= n; i += 8) acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i), acc0);
+    float s = hsum256(_mm256_add_ps(_mm256_add_ps(acc0, acc1), _mm256_add_ps(acc2, acc3)));
+    for (; i < n; ++i) s += a[i] * b[i];
+    return s;
+}
+
+TARGET_AVX2 float l2Avx2(const float* a, const float* b, int n) {
+    __m256 acc0 = _mm256_setzero_ps(), acc1 = _mm256_setzero_ps();
+    int i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m256 d0 = _mm256_sub_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i));
+        __m256 d1 = _mm256_sub_ps(_mm256_loadu_ps(a + i + 8), _mm256_loadu_ps(b + i + 8));
+        acc0 = _mm256_fmadd_ps(d0, d0, acc0);
+        acc1 = _mm256_fmadd_ps(d1, d1, acc1);
+    }
+    for (; i + 8 <= n; i += 8) {
+        __m256 d = _mm256_sub_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i));
+        acc0 = _mm256_fmadd_ps(d, d, acc0);
+    }
+    float s = hsum256(_mm256_add_ps(acc0, acc1));
+    for (; i < n; ++i) { float d = a[i] - b[i]; s += d * d; }
+    return s;
+}
+
+TARGET_AVX2 void cosineAvx2(const float* a, const float* b, int n, float& d, float& na, float& nb) {
+    __m256 accD = _mm256_setzero_ps(), accA = _mm256_setzero_ps(), accB = _mm256_setzero_ps();
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256 va = _mm256_loadu_ps(a + i), vb = _mm256_loadu_ps(b + i);
+        accD = _mm256_fmadd_ps(va, vb, accD);
+        accA = _mm256_fmadd_ps(va, va, accA);
+        accB = _mm256_fmadd_ps(vb, vb, accB);
+    }
+    d = hsum256(accD); na = hsum256(accA); nb = hsum256(accB);
+    for (; i < n; ++i) { d += a[i] * b[i]; na += a[i] * a[i]; nb += b[i] * b[i]; }
+}
+
+TARGET_AVX2 void dot4Avx2(const float* a, const float* const* b, int n, float* out) {
+    __m256 acc0 = _mm256_setzero_ps(), acc1 = _mm256_setzero_ps(), acc2 = _mm256_setzero_ps(), acc3 = _mm256_setzero_ps();
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256 va = _mm256_loadu_ps(a + i);
+        acc0 = _mm256_fmadd_ps(va, _mm256_loadu_ps(b[0] + i), acc0);
+        acc1 = _mm256_fmadd_ps(va, _mm256_loadu_ps(b[1] + i), acc1);
+        acc2 = _mm256_fmadd_ps(va, _mm256_loadu_ps(b[2] + i), acc2);
+        acc3 = _mm256_fmadd_ps(va, _mm256_loadu_ps(b[3] + i), acc3);
+    }
+    out[0] = hsum256(acc0); out[1] = hsum256(acc1); out[2] = hsum256(acc2); out[3] = hsum256(acc3);
+    for (; i < n; ++i) {
+        for (int j = 0; j < 4; ++j) out[j] += a[i] * b[j][i];
+    }
+}
+
+TARGET_AVX2 int32_t dotInt8Avx2(const int8_t* a, const int8_t* b, int n) {
+    // pmaddubsw multiplies unsigned x signed bytes, so move a's sign onto b first.
+    // |a|,|b| <= 127 keeps each pair sum (<= 32258) clear of int16 saturation.
+    const __m256i ones = _mm256_set1_epi16(1);
+    __m256i acc0 = _mm256_setzero_si256(), acc1 = _mm256_setzero_si256();
+    int i = 0;
+    for (; i + 64 <= n; i += 64) {
+        __m256i va0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+        __m256i vb0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i));
+        __m256i va1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i + 32));
+        __m256i vb1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i + 32));
+        acc0 = _mm256_add_epi32(acc0, _mm256_madd_epi16(_mm256_maddubs_epi16(_mm256_abs_epi8(va0), _mm256_sign_epi8(vb0, va0)), ones));
+        acc1 = _mm256_add_epi32(acc1, _mm256_madd_epi16(_mm256_maddubs_epi16(_mm256_abs_epi8(va1), _mm256_sign_epi8(vb1, va1)), ones));
+    }
+    for (; i + 32 <= n; i += 32) {
+        __m256i va = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+        __m256i vb = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i));
+        acc0 = _mm256_add_epi32(acc0, _mm256_madd_epi16(_mm256_maddubs_epi16(_mm256_abs_epi8(va), _mm256_sign_epi8(vb, va)), ones));
+    }
+    __m256i acc = _mm256_add_epi32(acc0, acc1);
+    int32_t s = hsum128i(_mm_add_epi32(_mm256_castsi256_si128(acc), _mm256_extracti128_si256(acc, 1)));
+    for (; i < n; ++i) s += (int32_t)a[i] * b[i];
+    return s;
+}
+
+// Every AVX2-capable CPU also has POPCNT, so the AVX2/AVX-512 levels use the instruction
+#if defined(_MSC_VER) && defined(_M_X64)
+#define POPCNT64(x) (int)__popcnt64(x)
+#elif defined(_MSC_VER)
+#define POPCNT64(x) (int)(__popcnt((unsigned int)(x)) + __popcnt((unsigned int)((x) >> 32)))
+#else
+#define POPCNT64(x) __builtin_popcountll(x)
+#endif
+
+TARGET_POPCNT int hammingPopcnt(const uint64_t* a, const uint64_t* b, int words) {
+    int s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+    int i = 0;
+    for (; i + 4 <= words; i += 4) {
+        s0 += POPCNT64(a[i] ^ b[i]);
+        s1 += POPCNT64(a[i + 1] ^ b[i + 1]);
+        s2 += POPCNT64(a[i + 2] ^ b[i + 2]);
+        s3 += POPCNT64(a[i + 3] ^ b[i + 3]);
+    }
+    for (; i < words; ++i) s0 += POPCNT64(a[i] ^ b[i]);
+    return (s0 + s1) + (s2 + s3);
+}
+
+// F16C converts 8 lanes per instruction; bf16 widening is a zero-extend and shift
+TARGET_F16C void halfToFloatF16c(const uint16_t* in, float* out, int n) {
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        _mm256_storeu_ps(out + i, _mm256_cvtph_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i))));
+    }
+    for (; i < n; ++i) out[i] = halfBitsToFloat(in[i]);
+}
+
+TARGET_F16C void floatToHalfF16c(const float* in, uint16_t* out, int n) {
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm256_cvtps_ph(_mm256_loadu_ps(in + i), _MM_FROUND_TO_NEAREST_INT));
+    }
+    for (; i < n; ++i) out[i] = floatToHalfBits(in[i]);
+}
+
+TARGET_AVX2 void bf16ToFloatAvx2(const uint16_t* in, float* out, int n) {
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256i wide = _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i)));
+        _mm256_storeu_ps(out + i, _mm256_castsi256_ps(_mm256_slli_epi32(wide, 16)));
+    }
+    bf16ToFloatScalar(in + i, out + i, n - i);
+}
+
+// --- AVX-512F (masked tails, no scalar remainder) ---
+
+TARGET_AVX512 float dotAvx512(const float* a, const float* b, int n) {
+    __m512 acc0 = _mm512_setzero_ps(), acc1 = _mm512_setzero_ps();
+    int i = 0;
+    for (; i + 32 <= n; i += 32) {
+        acc0 = _mm512_fmadd_ps(_mm512_loadu_ps(a + i), _mm512_loadu_ps(b + i), acc0);
+        acc1 = _mm512_fmadd_ps(_mm512_loadu_ps(a + i + 16), _mm512_loadu_ps(b + i + 16), acc1);
+    }
+    for (; i < n; i += 16) {
+        __mmask16 m = (n - i >= 16) ? (__mmask16)0xFFFF : (__mmask16)((1u << (n - i)) - 1);
+        acc0 = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(m, a + i), _mm512_maskz_loadu_ps(m, b + i), acc0);
+    }
+    return _mm512_reduce_add_ps(_mm512_add_ps(acc0, acc1));
+}
+
+TARGET_AVX512 float l2Avx512(const float* a, const float* b, int n) {
+    __m512 acc = _mm512_setzero_ps();
+    for (int i = 0; i < n; i += 16) {
+        __mmask16 m = (n - i >= 16) ? (__mmask16)0xFFFF : (__mmask16)((1u << (n - i)) - 1);
+        __m512 d = _mm512_sub_ps(_mm512_maskz_loadu_ps(m, a + i), _mm512_maskz_loadu_ps(m, b + i));
+        acc = _mm512_fmadd_ps(d, d, acc);
+    }
+    return _mm512_reduce_add_ps(acc);
+}
+
+TARGET_AVX512 void cosineAvx512(const float* a, const float* b, int n, float& d, float& na, float& nb) {
+    __m512 accD = _mm512_setzero_ps(), accA = _mm512_setzero_ps(), accB = _mm512_setzero_ps();
+    for (int i = 0; i < n; i += 16) {
+        __mmask16 m = (n - i >= 16) ? (__mmask16)0xFFFF : (__mmask16)((1u << (n - i)) - 1);
+        __m512 va = _mm512_maskz_loadu_ps(m, a + i), vb = _mm512_maskz_loadu_ps(m, b + i);
+        accD = _mm512_fmadd_ps(va, vb, accD);
+        accA = _mm512_fmadd_ps(va, va, accA);
+        accB = _mm512_fmadd_ps(vb, vb, accB);
+    }
+    d = _mm512_reduce_add_ps(accD); na = _mm512_reduce_add_ps(accA); nb = _mm512_reduce_add_ps(accB);
+}
+
+TARGET_AVX512 void dot4Avx512(const float* a, const float* const* b, int n, float* out) {
+    __m512 acc0 = _mm512_setzero_ps(), acc1 = _mm512_setzero_ps(), acc2 = _mm512_setzero_ps(), acc3 = _mm512_setzero_ps();
+    for (int i = 0; i < n; i += 16) {
+        __mmask16 m = (n - i >= 16) ? (__mmask16)0xFFFF : (__mmask16)((1u << (n - i)) - 1);
+        __m512 va = _mm512_maskz_loadu_ps(m, a + i);
+        acc0 = _mm512_fmadd_ps(va, _mm512_maskz_loadu_ps(m, b[0] + i), acc0);
+        acc1 = _mm512_fmadd_ps(va, _mm512_maskz_loadu_ps(m, b[1] + i), acc1);
+        acc2 = _mm512_fmadd_ps(va, _mm512_maskz_loadu_ps(m, b[2] + i), acc2);
+        acc3 = _mm512_fmadd_ps(va, _mm512_maskz_loadu_ps(m, b[3] + i), acc3);
+    }
+    out[0] = _mm512_reduce_add_ps(acc0); out[1] = _mm512_reduce_add_ps(acc1);
+    out[2] = _mm512_reduce_add_ps(acc2); out[3] = _mm512_reduce_add_ps(acc3);
+}
+
+// --- Fixed-width kernels ---
+// N is a compile-time multiple of 64: every loop has a constant trip count and no tail
+// handling, so the compiler is free to unroll the blocked body.
+// Four independent accumulators hide the FMA latency; they are named rather than an
+// array so they are never spilled to the stack.
+
+template <int N>
+float fixedSse2(const float* a, const float* b, int) {
+    static_assert(N % 64 == 0, "fixed kernels assume whole 64-float blocks");
+    __m128 acc0 = _mm_setzero_ps(), acc1 = _mm_setzero_ps(), acc2 = _mm_setzero_ps(), acc3 = _mm_setzero_ps();
+    for (int i = 0; i < N; i += 16) {
+        acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+        acc1 = _mm_add_ps(acc1, _mm_mul_ps(_mm_loadu_ps(a + i + 4), _mm_loadu_ps(b + i + 4)));
+        acc2 = _mm_add_ps(acc2, _mm_mul_ps(_mm_loadu_ps(a + i + 8), _mm_loadu_ps(b + i + 8)));
+        acc3 = _mm_add_ps(acc3, _mm_mul_ps(_mm_loadu_ps(a + i + 12), _mm_loadu_ps(b + i + 12)));
+    }
+    return hsum128(_mm_add_ps(_mm_add_ps(acc0, acc1), _mm_add_ps(acc2, acc3)));
+}
+
+template <int N>
+TARGET_AVX2 float fixedAvx2(const float* a, const float* b, int) {
+    static_assert(N % 64 == 0, "fixed kernels assume whole 64-float blocks");
+    __m256 acc0 = _mm256_setzero_ps(), acc1 = _mm256_setzero_ps(), acc2 = _mm256_setzero_ps(), acc3 = _mm256_setzero_ps();
+    for (int i = 0; i < N; i += 32) {
+        acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i), acc0);
+        acc1 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i + 8), _mm256_loadu_ps(b + i + 8), acc1);
+        acc2 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i + 16), _mm256_loadu_ps(b + i + 16), acc2);
+        acc3 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i + 24), _mm256_loadu_ps(b + i + 24), acc3);
+    }
+    return hsum256(_mm256_add_ps(_mm256_add_ps(acc0, acc1), _mm256_add_ps(acc2, acc3)));
+}
+
+template <int N>
+TARGET_AVX512 float fixedAvx512(const float* a, const float* b, int) {
+    static_assert(N % 64 == 0, "fixed kernels assume whole 64-float blocks");
+    __m512 acc0 = _mm512_setzero_ps(), acc1 = _mm512_setzero_ps(), acc2 = _mm512_setzero_ps(), acc3 = _mm512_setzero_ps();
+    for (int i = 0; i < N; i += 64) {
+        acc0 = _mm512_fmadd_ps(_mm512_loadu_ps(a + i), _mm512_loadu_ps(b + i), acc0);
+        acc1 = _mm512_fmadd_ps(_mm512_loadu_ps(a + i + 16), _mm512_loadu_ps(b + i + 16), acc1);
+        acc2 = _mm512_fmadd_ps(_mm512_loadu_ps(a + i + 32), _mm512_loadu_ps(b + i + 32), acc2);
+        acc3 = _mm512_fmadd_ps(_mm512_loadu_ps(a + i + 48), _mm512_loadu_ps(b + i + 48), acc3);
+    }
+    return _mm512_reduce_add_ps(_mm512_add_ps(_mm512_add_ps(acc0, acc1), _mm512_add_ps(acc2, acc3)));
+}
+
+// --- CPU detection ---
+
+#if defined(_MSC_VER)
+bool osSupportsXsave(unsigned long long mask) {
+    return (_xgetbv(0) & mask) == mask;
+}
+#endif
+
+bool detectF16c() {
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 1);
+    return (info[2] & (1 << 29)) != 0;
+#else
+    return __builtin_cpu_supports("f16c");
+#endif
+}
+
+Level detectLevel() {
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0);
+    int maxLeaf = info[0];
+    __cpuid(info, 1);
+    bool osxsave = (info[2] & (1 << 27)) != 0;
+    bool fma = (info[2] & (1 << 12)) != 0;
+    bool avx = (info[2] & (1 << 28)) != 0;
+    bool avx2 = false, avx512 = false;
+    if (maxLeaf >= 7) {
+        __cpuidex(info, 7, 0);
+        avx2 = (info[1] & (1 << 5)) != 0;
+        avx512 = (info[1] & (1 << 16)) != 0;
+    }
+    if (osxsave && avx512 && osSupportsXsave(0xE6)) return Level::AVX512; // XMM|YMM|opmask|ZMM state
+    if (osxsave && avx && avx2 && fma && osSupportsXsave(0x6)) return Level::AVX2;
+    return Level::SSE2;
+#else
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) return Level::AVX512;
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) return Level::AVX2;
+    return Level::SSE2;
+#endif
+}
+
+#endif // SIMD_KERNELS_X86
+
+KernelTable buildTable() {
+#ifdef SIMD_KERNELS_X86
+    const Level level = detectLevel();
+    const bool avx2 = level != Level::SSE2;
+    const bool f16c = avx2 && detectF16c();
+    const auto toFloat = f16c ? halfToFloatF16c : halfToFloatScalar;
+    const auto toHalf = f16c ? floatToHalfF16c : floatToHalfScalar;
+    const auto bf16 = avx2 ? bf16ToFloatAvx2 : bf16ToFloatScalar;
+    switch (level) {
+    // AVX-512F has no byte multiplies (that needs BW/VNNI), so int8 stays on the AVX2 kernel
+    case Level::AVX512: return {Level::AVX512, dotAvx512, l2Avx512, cosineAvx512, dot4Avx512, dotInt8Avx2, hammingPopcnt, toFloat, toHalf, bf16};
+    case Level::AVX2:   return {Level::AVX2, dotAvx2, l2Avx2, cosineAvx2, dot4Avx2, dotInt8Avx2, hammingPopcnt, toFloat, toHalf, bf16};
+    default:            return {Level::SSE2, dotSse2, l2Sse2, cosineSse2, dot4Sse2, dotInt8Sse2, hammingSwar, toFloat, toHalf, bf16};
+    }
+#else
+    return {Level::Scalar, dotScalar, l2Scalar, cosineScalar, dot4Scalar, dotInt8Scalar, hammingSwar,
+            halfToFloatScalar, floatToHalfScalar, bf16ToFloatScalar};
+#endif
+}
+
+const KernelTable& table() {
+    static const KernelTable t = buildTable(); // Selected once, thread-safe init
+    return t;
+}
+
+template <int N>
+ScoreFn fixedKernel(Level level) {
+#ifdef SIMD_KERNELS_X86
+    switch (level) {
+    case Level::AVX512: return fixedAvx512<N>;
+    case Level::AVX2:   return fixedAvx2<N>;
+    default:            return fixedSse2<N>;
+    }
+#else
+    (void)level;
+    return fixedScalar<N>;
+#endif
+}
+
+float negL2Squared(const float* a, const float* b, int n) { return -table().l2(a, b, n); }
+
+} // namespace
+
+Level activeLevel() { return table().level; }
+
+const char* levelName() {
+    switch (activeLevel()) {
+    case Level::AVX512: return "AVX-512";
+    case Level::AVX2:   return "AVX2+FMA";
+    case Level::SSE2:   return "SSE2";
+    default:            return "Scalar";
+    }
+}
+
+float dot(const float* a, const float* b, int n) { return table().dot(a, b, n); }
+
+float l2Squared(const float* a, const float* b, int n) { return table().l2(a, b, n); }
+
+void dot4(const float* a, const float* const* b, int n, float* out) { table().dot4(a, b, n, out); }
+
+float cosine(const float* a, const float* b, int n) {
+    float d, na, nb;
+    table().cosineParts(a, b, n, d, na, nb);
+    return cosineFrom(d, na, nb);
+}
+
+ScoreFn scoreKernel(int dim, Metric metric) {
+    switch (metric) {
+    case Metric::Cosine: return cosine;
+    case Metric::L2:     return negL2Squared;
+    default:             break;
+    }
+    const Level level = activeLevel();
+    switch (dim) {
+    case 768:  return fixedKernel<768>(level);  // nomic-embed-text
+    case 1024: return fixedKernel<1024>(level);
+    case 1536: return fixedKernel<1536>(level);
+    case 3072: return fixedKernel<3072>(level); // gemini-embedding-001
+    default:   return dot;
+    }
+}
+
+bool hasFixedKernel(int dim) {
+    return dim == 768 || dim == 1024 || dim == 1536 || dim == 3072;
+}
+
+int32_t dotInt8(const int8_t* a, const int8_t* b, int n) { return table().dotInt8(a, b, n); }
+
+int hamming(const uint64_t* a, const uint64_t* b, int words) { return table().hamming(a, b, words); }
+
+void halfToFloat(const uint16_t* in, float* out, int n) { table().halfToFloat(in, out, n); }
+
+void floatToHalf(const float* in, uint16_t* out, int n) { table().floatToHalf(in, out, n); }
+
+void bf16ToFloat(const uint16_t* in, float* out, int n) { table().bf16ToFloat(in, out, n); }
+
+void floatToBf16(const float* in, uint16_t* out, int n) {
+    // Write path only, so no SIMD variant: round to nearest even, keep NaNs quiet
+    for (int i = 0; i < n; ++i) {
+        uint32_t x;
+        memcpy(&x, in + i, sizeof(x));
+        if ((x & 0x7FFFFFFF) > 0x7F800000) out[i] = (uint16_t)((x >> 16) | 0x40);
+        else out[i] = (uint16_t)((x + 0x7FFF + ((x >> 16) & 1)) >> 16);
+    }
+}
+
+float normalize(float* v, int n) {
+    float norm = std::sqrt(dot(v, v, n));
+    if (norm > 0.0f) {
+        float inv = 1.0f / norm;
+        for (int i = 0; i < n; ++i) v[i] *= inv;
+    }
+    return norm;
+}
+
+} // namespace SimdKernels
@@ -0,0 +1,49 @@
+#ifndef SIMD_KERNELS_H
+#define SIMD_KERNELS_H
+
+#include <cstdint>
+
+// Float32 similarity kernels with runtime CPU dispatch.
+// The best variant (Scalar < SSE2 < AVX2+FMA < AVX-512) is picked once via cpuid
+// on first use; every similarity computation in the app routes through here.
+namespace SimdKernels {
+
+enum class Level { Scalar, SSE2, AVX2, AVX512 };
+
+Level activeLevel();
+const char* levelName();
+
+float dot(const float* a, const float* b, int n);
+float l2Squared(const float* a, const float* b, int n);
+float cosine(const float* a, const float* b, int n); // 0.0 if either vector has zero norm
+float normalize(float* v, int n); // Scales v to unit length in place, returns the original L2 norm
+
+// Similarity kernel resolved for one vector width; higher is more similar, so L2 yields
+// the negated squared distance. For Dot, the common embedding widths (768, 1024, 1536,
+// 3072) get compile-time-sized bodies with no remainder handling. The store only ranks
+// by Dot (rows and queries are unit length), so Cosine and L2 always get the generic
+// kernels above. Resolve once per workspace rather than per call.
+enum class Metric { Dot, Cosine, L2 };
+using ScoreFn = float (*)(const float* a, const float* b, int n);
+ScoreFn scoreKernel(int dim, Metric metric = Metric::Dot);
+bool hasFixedKernel(int dim);
+
+// GEMM-style 1x4 micro-kernel: out[j] = dot(a, b[j]) with each block of a loaded once
+void dot4(const float* a, const float* const* b, int n, float* out);
+
+// Exact int32 dot product of int8 codes; inputs must stay within [-127, 127]
+int32_t dotInt8(const int8_t* a, const int8_t* b, int n);
+
+// Number of differing bits between two bit-packed sketches
+int hamming(const uint64_t* a, const uint64_t* b, int words);
+
+// Half-precision storage conversions (IEEE fp16 via F16C when available, bf16 via shifts).
+// Narrowing rounds to nearest even.
+void halfToFloat(const uint16_t* in, float* out, int n);
+void floatToHalf(const float* in, uint16_t* out, int n);
+void bf16ToFloat(const uint16_t* in, float* out, int n);
+void floatToBf16(const float* in, uint16_t* out, int n);
+
+} // namespace SimdKernels
+
+#endif // SIMD_KERNELS_H
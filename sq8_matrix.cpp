@@ -0,0 +1,63 @@
+#include "sq8_matrix.h"
+#include <cmath>
+#include <cstring>
+
+void Sq8Matrix::reset(int dim) {
+    clear();
+    m_dim = dim;
+    m_stride = ((dim + kRowAlignment - 1) / kRowAlignment) * kRowAlignment;
+}
+
+void Sq8Matrix::clear() {
+    m_dim = 0;
+    m_stride = 0;
+    m_codes.clear();
+    m_scales.clear();
+}
+
+void Sq8Matrix::reserve(int rows) {
+    m_codes.reserve(rows * m_stride);
+    m_scales.reserve(rows);
+}
+
+int Sq8Matrix::append(const int8_t* code, float scale) {
+    if (m_dim <= 0) return -1;
+    int r = rows();
+    m_codes.resize((r + 1) * m_stride); // Value-initialized, so the padding is zero
+    memcpy(m_codes.data() + (size_t)r * m_stride, code, m_dim);
+    m_scales.append(scale);
+    return r;
+}
+
+int Sq8Matrix::append(const float* vec) {
+    QVector<int8_t> code(m_dim);
+    float scale = quantize(vec, m_dim, code.data());
+    return append(code.constData(), scale);
+}
+
+float Sq8Matrix::quantize(const float* vec, int n, int8_t* code) {
+    float maxAbs = 0.0f;
+    for (int i = 0; i < n; ++i) maxAbs = qMax(maxAbs, std::fabs(vec[i]));
+    if (maxAbs <= 0.0f) {
+        memset(code, 0, n);
+        return 0.0f;
+    }
+    // Clamp to +-127 (never -128) so the kernels' sign tricks can't overflow
+    float inv = 127.0f / maxAbs;
+    for (int i = 0; i < n; ++i) code[i] = (int8_t)qBound(-127L, std::lround(vec[i] * inv), 127L);
+    return maxAbs / 127.0f;
+}
+
+QByteArray Sq8Matrix::toBlob(const int8_t* code, int n, float scale) {
+    QByteArray blob(sizeof(float) + n, Qt::Uninitialized);
+    memcpy(blob.data(), &scale, sizeof(float));
+    memcpy(blob.data() + sizeof(float), code, n);
+    return blob;
+}
+
+bool Sq8Matrix::fromBlob(const QByteArray& blob, int n, int8_t* code, float& scale) {
+    if (blob.size() != (int)sizeof(float) + n) return false;
+    memcpy(&scale, blob.constData(), sizeof(float));
+    memcpy(code, blob.constData() + sizeof(float), n);
+    return true;
+}
@@ -0,0 +1,44 @@
+#ifndef SQ8_MATRIX_H
+#define SQ8_MATRIX_H
+
+#include <QVector>
+#include <QByteArray>
+#include <cstdint>
+
+// Resident int8 copy of the embedding matrix (scalar quantization, SQ8).
+// Each unit-length row is stored as round(x / scale) with a per-row symmetric scale
+// (max |x| / 127), so dot(a, b) ~= scale_a * scale_b * int8dot(a, b). Rows are padded
+// to 64 bytes; the scan reads a quarter of the float matrix's bytes.
+class Sq8Matrix {
+public:
+    static constexpr int kRowAlignment = 64;
+
+    void reset(int dim);
+    void clear();
+    void reserve(int rows);
+    int append(const int8_t* code, float scale); // Returns the row ordinal
+    int append(const float* vec);                 // Quantizes, returns the row ordinal
+
+    int dimension() const { return m_dim; }
+    int stride() const { return m_stride; }
+    int rows() const { return m_scales.size(); }
+    bool isEmpty() const { return m_scales.isEmpty(); }
+
+    const int8_t* row(int r) const { return m_codes.constData() + (size_t)r * m_stride; }
+    float scale(int r) const { return m_scales[r]; }
+
+    // Symmetric per-vector quantization; code must hold n bytes. Returns the scale.
+    static float quantize(const float* vec, int n, int8_t* code);
+
+    // Column format for embeddings.sq8_blob: float scale followed by dim int8 codes
+    static QByteArray toBlob(const int8_t* code, int n, float scale);
+    static bool fromBlob(const QByteArray& blob, int n, int8_t* code, float& scale);
+
+private:
+    int m_dim = 0;
+    int m_stride = 0;
+    QVector<int8_t> m_codes;  // rows x stride, padding zeroed
+    QVector<float> m_scales;
+};
+
+#endif // SQ8_MATRIX_H
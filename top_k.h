@@ -0,0 +1,60 @@
+#ifndef TOP_K_H
+#define TOP_K_H
+
+#include <QVector>
+#include <algorithm>
+
+struct ScoredRow {
+    int row;     // Ordinal in the resident matrix
+    float score;
+};
+
+// Fixed-capacity min-heap keeping the k best (row, score) pairs seen during a scan.
+// Ties break towards the lower row ordinal (rows are appended in id order), so the
+// selection is deterministic regardless of push or merge order.
+class TopK {
+public:
+    explicit TopK(int k = 0) : m_k(qMax(0, k)) { m_heap.reserve(m_k); }
+
+    static bool better(const ScoredRow& a, const ScoredRow& b) {
+        return a.score > b.score || (a.score == b.score && a.row < b.row);
+    }
+
+    int capacity() const { return m_k; }
+    int size() const { return m_heap.size(); }
+    bool isFull() const { return m_heap.size() >= m_k; }
+
+    // Score a candidate must beat to enter once the heap is full
+    float threshold() const { return isFull() && m_k > 0 ? m_heap.first().score : -1e30f; }
+
+    void push(int row, float score) {
+        if (m_k == 0) return;
+        ScoredRow cand{row, score};
+        if (!isFull()) {
+            m_heap.append(cand);
+            std::push_heap(m_heap.begin(), m_heap.end(), better);
+        } else if (better(cand, m_heap.first())) {
+            std::pop_heap(m_heap.begin(), m_heap.end(), better);
+            m_heap.last() = cand;
+            std::push_heap(m_heap.begin(), m_heap.end(), better);
+        }
+    }
+
+    void merge(const TopK& other) {
+        for (const ScoredRow& r : other.m_heap) push(r.row, r.score);
+    }
+
+    // Best first; leaves the selector empty
+    QVector<ScoredRow> takeSorted() {
+        std::sort(m_heap.begin(), m_heap.end(), better);
+        QVector<ScoredRow> out;
+        out.swap(m_heap);
+        return out;
+    }
+
+private:
+    int m_k;
+    QVector<ScoredRow> m_heap; // Heap ordered so the worst kept entry sits at front
+};
+
+#endif // TOP_K_H
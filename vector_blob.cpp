@@ -0,0 +1,99 @@
+#include "vector_blob.h"
+#include "simd_kernels.h"
+#include <cstring>
+
+namespace VectorBlob {
+
+namespace {
+
+const quint32 kMagic = 0x424C4256; // "VBLB" little-endian
+const quint8 kVersion = 1;
+
+struct Header {
+    quint32 magic;
+    quint8 version;
+    quint8 type;
+    quint16 reserved;
+    quint32 dim;
+};
+static_assert(sizeof(Header) == 12, "vector blob header must stay 12 bytes");
+
+int elementSize(Type type) { return type == Type::Float32 ? 4 : 2; }
+
+bool readHeader(const QByteArray& blob, Header& header) {
+    if (blob.size() < (int)sizeof(Header)) return false;
+    memcpy(&header, blob.constData(), sizeof(Header));
+    return header.magic == kMagic && header.version == kVersion && header.type <= (quint8)Type::BFloat16
+        && blob.size() == (int)sizeof(Header) + (int)header.dim * elementSize((Type)header.type);
+}
+
+} // namespace
+
+QByteArray encode(const float* vec, int dim, Type type) {
+    Header header{kMagic, kVersion, (quint8)type, 0, (quint32)dim};
+    QByteArray blob(sizeof(Header) + dim * elementSize(type), Qt::Uninitialized);
+    memcpy(blob.data(), &header, sizeof(Header));
+    char* payload = blob.data() + sizeof(Header);
+    switch (type) {
+    case Type::Float32:  memcpy(payload, vec, dim * sizeof(float)); break;
+    case Type::Float16:  SimdKernels::floatToHalf(vec, reinterpret_cast<uint16_t*>(payload), dim); break;
+    case Type::BFloat16: SimdKernels::floatToBf16(vec, reinterpret_cast<uint16_t*>(payload), dim); break;
+    }
+    return blob;
+}
+
+int dimension(const QByteArray& blob) {
+    Header header;
+    if (readHeader(blob, header)) return (int)header.dim;
+    return blob.size() % sizeof(float) == 0 ? blob.size() / (int)sizeof(float) : -1;
+}
+
+Type typeOf(const QByteArray& blob) {
+    Header header;
+    return readHeader(blob, header) ? (Type)header.type : Type::Float32;
+}
+
+bool decode(const QByteArray& blob, float* out, int dim) {
+    Header header;
+    if (!readHeader(blob, header)) {
+        if (blob.size() != dim * (int)sizeof(float)) return false;
+        memcpy(out, blob.constData(), blob.size()); // Legacy headerless float32
+        return true;
+    }
+    if ((int)header.dim != dim) return false;
+
+    const char* payload = blob.constData() + sizeof(Header);
+    switch ((Type)header.type) {
+    case Type::Float32:  memcpy(out, payload, dim * sizeof(float)); break;
+    case Type::Float16:  SimdKernels::halfToFloat(reinterpret_cast<const uint16_t*>(payload), out, dim); break;
+    case Type::BFloat16: SimdKernels::bf16ToFloat(reinterpret_cast<const uint16_t*>(payload), out, dim); break;
+    }
+    return true;
+}
+
+QVector<float> decode(const QByteArray& blob) {
+    QVector<float> vec;
+    int dim = dimension(blob);
+    if (dim <= 0) return vec;
+    vec.resize(dim);
+    if (!decode(blob, vec.data(), dim)) vec.clear();
+    return vec;
+}
+
+const char* typeName(Type type) {
+    switch (type) {
+    case Type::Float32:  return "f32";
+    case Type::Float16:  return "f16";
+    case Type::BFloat16: return "bf16";
+    }
+    return "f32";
+}
+
+Type typeFromName(const QString& name, Type fallback) {
+    if (name == "f32") return Type::Float32;
+    if (name == "f16") return Type::Float16;
+    if (name == "bf16") return Type::BFloat16;
+    return fallback;
+}
+
+} // namespace VectorBlob
@@ -0,0 +1,32 @@
+#ifndef VECTOR_BLOB_H
+#define VECTOR_BLOB_H
+
+#include <QByteArray>
+#include <QString>
+#include <QVector>
+
+// On-disk format of embeddings.vector_blob.
+// Current blobs start with a 12-byte header {magic "VBLB", version, dtype, reserved, dim}
+// followed by dim elements of dtype. Legacy blobs (pre-v19) are headerless float32; their
+// first word can't pass for the magic, which reads as the float ~51.1 (v16 made every
+// stored component unit-scaled), and the header must also match the blob length.
+namespace VectorBlob {
+
+enum class Type : quint8 { Float32 = 0, Float16 = 1, BFloat16 = 2 };
+
+QByteArray encode(const float* vec, int dim, Type type);
+
+// Element count and dtype without decoding (legacy blobs report Float32); -1 if malformed
+int dimension(const QByteArray& blob);
+Type typeOf(const QByteArray& blob);
+
+// Widens into out (dim floats); false if the blob is malformed or of another dimension
+bool decode(const QByteArray& blob, float* out, int dim);
+QVector<float> decode(const QByteArray& blob);
+
+const char* typeName(Type type);
+Type typeFromName(const QString& name, Type fallback = Type::Float32); // Unmarked workspaces hold float32
+
+} // namespace VectorBlob
+
+#endif // VECTOR_BLOB_H
@@ -0,0 +1,484 @@
+#include "vector_file.h"
+#include <QDebug>
+#include <QDateTime>
+#include <atomic>
+#include <cstring>
+
+namespace {
+
+const quint32 kVecMagic = 0x31434556; // "VEC1" (native byte order; a foreign file fails the check)
+const quint32 kVidMagic = 0x31444956; // "VID1"
+const quint32 kVlbMagic = 0x31424C56; // "VLB1"
+const quint32 kVectorFileVersion = 1;
+const int kLabelFlushBytes = 1 << 20;
+
+// Both headers carry the stamp of the write() that created the pair, so a .vec and a .vid
+// from different writes (a swap cut short, see commitStaged) are never read as one
+struct VecHeader {
+    quint32 magic;
+    quint32 version;
+    qint32 dim;
+    qint32 stride;
+    qint64 stamp;
+    char reserved[40]; // Pads the header to one cache line so row 0 stays 64-byte aligned
+};
+static_assert(sizeof(VecHeader) == VectorMatrix::kAlignment, "row data must start on a cache line");
+
+struct VidHeader {
+    quint32 magic;
+    quint32 version;
+    qint64 stamp;
+};
+static_assert(sizeof(VidHeader) == 16, "ids start after a 16-byte header");
+
+struct VlbHeader {
+    quint32 magic;
+    quint32 version;
+    qint32 words; // Sketch words per row
+    qint32 reserved;
+    qint64 stamp;
+};
+
+// Labels log entries: a tag byte, then
+//   'N'  kind (1 byte), UTF-8 length (4 bytes), UTF-8 name   -- next ordinal of that kind
+//   'R'  doc, type, heading ordinals and heading level (4 x int32), sketch words
+//   'X'  row (int32) deleted
+const char kNameEntry = 'N';
+const char kRowEntry = 'R';
+const char kDeletedEntry = 'X';
+
+qint64 newStamp() {
+    // Milliseconds plus a sequence number: two writes within one millisecond still differ
+    static std::atomic<quint32> sequence{0};
+    return (QDateTime::currentMSecsSinceEpoch() << 16) | (sequence++ & 0xFFFF);
+}
+
+void putName(QByteArray& out, int kind, const QString& name) {
+    const QByteArray utf8 = name.toUtf8();
+    const quint32 bytes = utf8.size();
+    out.append(kNameEntry);
+    out.append(char(kind));
+    out.append(reinterpret_cast<const char*>(&bytes), sizeof(bytes));
+    out.append(utf8);
+}
+
+void putRow(QByteArray& out, const RowLabels& labels, const BinaryMatrix& bits, int row) {
+    const qint32 record[4] = {labels.doc[row], labels.type[row], labels.heading[row], labels.level[row]};
+    out.append(kRowEntry);
+    out.append(reinterpret_cast<const char*>(record), sizeof(record));
+    out.append(reinterpret_cast<const char*>(bits.row(row)), bits.words() * (int)sizeof(uint64_t));
+}
+
+void putDeleted(QByteArray& out, int row) {
+    const qint32 r = row;
+    out.append(kDeletedEntry);
+    out.append(reinterpret_cast<const char*>(&r), sizeof(r));
+}
+
+// Moves `staged` over `live`. POSIX unlinks a mapped file and leaves its pages to whoever
+// still maps it. Windows refuses to delete or rename over a file that any process maps:
+// the live file then stays as it is and false tells the caller to carry on without it.
+bool replaceFile(const QString& staged, const QString& live) {
+    if (QFile::exists(live) && !QFile::remove(live)) return false;
+    return QFile::rename(staged, live);
+}
+
+int strideFor(int dim) {
+    return ((dim + VectorMatrix::kFloatsPerLine - 1) / VectorMatrix::kFloatsPerLine) * VectorMatrix::kFloatsPerLine;
+}
+
+} // namespace
+
+VectorFile::~VectorFile() {
+    close();
+}
+
+void VectorFile::setPaths(const QString& vecPath, const QString& idPath) {
+    close();
+    m_vecPath = vecPath;
+    m_idPath = idPath;
+    m_stamp = 0;
+    m_labels = LabelLog();
+}
+
+QString VectorFile::labelPath() const {
+    QString path = m_vecPath;
+    if (path.endsWith(".vec")) path.chop(4);
+    return path + ".vlb";
+}
+
+bool VectorFile::open(int dim) {
+    close();
+    if (dim <= 0 || !QFile::exists(m_vecPath) || !QFile::exists(m_idPath)) return false;
+
+    m_mapped.setFileName(m_vecPath);
+    QFile idFile(m_idPath);
+    if (!m_mapped.open(QIODevice::ReadOnly) || !idFile.open(QIODevice::ReadOnly)) {
+        close();
+        return false;
+    }
+
+    VecHeader vh;
+    VidHeader ih;
+    if (m_mapped.read(reinterpret_cast<char*>(&vh), sizeof(vh)) != sizeof(vh)
+        || idFile.read(reinterpret_cast<char*>(&ih), sizeof(ih)) != sizeof(ih)
+        || vh.magic != kVecMagic || vh.version != kVectorFileVersion
+        || ih.magic != kVidMagic || ih.version != kVectorFileVersion) {
+        qDebug() << "Vector sidecar has an unknown format:" << m_vecPath;
+        close();
+        return false;
+    }
+    if (vh.stamp != ih.stamp) {
+        qDebug() << "Vector sidecar files are from different writes:" << m_vecPath;
+        close();
+        return false;
+    }
+    if (vh.dim != dim || vh.stride != strideFor(dim)) {
+        close();
+        return false;
+    }
+
+    // Only rows complete in both files count; a torn append is cut off here
+    const qint64 recordBytes = (qint64)vh.stride * sizeof(float);
+    const qint64 vecRows = (m_mapped.size() - (qint64)sizeof(vh)) / recordBytes;
+    const qint64 idRows = (idFile.size() - (qint64)sizeof(ih)) / (qint64)sizeof(qint32);
+    const int rows = (int)qMin(vecRows, idRows);
+
+    const qint64 idBytes = (qint64)rows * (qint64)sizeof(qint32);
+    m_ids.resize(rows);
+    if (idFile.read(reinterpret_cast<char*>(m_ids.data()), idBytes) != idBytes) {
+        close();
+        return false;
+    }
+    for (int r = 1; r < rows; ++r) {
+        if (m_ids[r] <= m_ids[r - 1]) { // Rows must follow id order like the resident matrix
+            qDebug() << "Vector sidecar is corrupt:" << m_idPath;
+            close();
+            return false;
+        }
+    }
+
+    if (rows > 0) {
+        m_map = m_mapped.map(0, (qint64)sizeof(vh) + rows * recordBytes);
+        if (!m_map) {
+            qDebug() << "Vector sidecar could not be mapped:" << m_mapped.errorString();
+            close();
+            return false;
+        }
+        m_data = reinterpret_cast<const float*>(m_map + sizeof(vh));
+    }
+    m_rows = rows;
+    m_dim = dim;
+    m_stamp = vh.stamp;
+    return true;
+}
+
+void VectorFile::close() {
+    if (m_map) m_mapped.unmap(m_map);
+    m_map = nullptr;
+    m_data = nullptr;
+    m_mapped.close();
+    m_vecOut.close();
+    m_idOut.close();
+    m_labelOut.close(); // The log state stays: it still describes the files for a reopen
+    m_ids.clear();
+    m_rows = 0;
+}
+
+bool VectorFile::writeHeaders(QFile& vec, QFile& ids, const VectorMatrix& matrix, qint64 stamp) {
+    VecHeader vh;
+    memset(&vh, 0, sizeof(vh));
+    vh.magic = kVecMagic;
+    vh.version = kVectorFileVersion;
+    vh.dim = matrix.dimension();
+    vh.stride = matrix.stride();
+    vh.stamp = stamp;
+    VidHeader ih = {kVidMagic, kVectorFileVersion, stamp};
+    return vec.write(reinterpret_cast<const char*>(&vh), sizeof(vh)) == sizeof(vh)
+        && ids.write(reinterpret_cast<const char*>(&ih), sizeof(ih)) == sizeof(ih);
+}
+
+bool VectorFile::write(const VectorMatrix& matrix, const RowLabels* labels, const BinaryMatrix* bits) {
+    close();
+    return stage(matrix, labels, bits) && commitStaged();
+}
+
+bool VectorFile::stage(const VectorMatrix& matrix, const RowLabels* labels, const BinaryMatrix* bits) {
+    if (matrix.dimension() <= 0) return false;
+    const qint64 stamp = newStamp();
+
+    // Written beside the live files and swapped in, so another process that still maps
+    // the old .vec is never left faulting on a truncated file
+    QFile vec(m_vecPath + ".tmp");
+    QFile ids(m_idPath + ".tmp");
+    bool ok = vec.open(QIODevice::WriteOnly | QIODevice::Truncate)
+        && ids.open(QIODevice::WriteOnly | QIODevice::Truncate) && writeHeaders(vec, ids, matrix, stamp);
+
+    const qint64 recordBytes = (qint64)matrix.stride() * sizeof(float);
+    for (int r = 0; ok && r < matrix.rows(); ++r) {
+        ok = vec.write(reinterpret_cast<const char*>(matrix.row(r)), recordBytes) == recordBytes;
+    }
+    const qint64 idBytes = (qint64)matrix.rows() * sizeof(qint32);
+    ok = ok && ids.write(reinterpret_cast<const char*>(matrix.ids().constData()), idBytes) == idBytes;
+    vec.close();
+    ids.close();
+
+    // Without labels the log is left out; the one on disk then carries an older stamp
+    m_stagedLabels = LabelLog();
+    if (ok && labels && bits && !writeLabelLog(labelPath() + ".tmp", stamp, *labels, *bits, matrix.rows(), nullptr, m_stagedLabels)) {
+        QFile::remove(labelPath() + ".tmp");
+        m_stagedLabels = LabelLog();
+    }
+
+    if (!ok) {
+        discardStaged();
+        qDebug() << "Vector sidecar write failed:" << m_vecPath;
+    }
+    return ok;
+}
+
+bool VectorFile::commitStaged() {
+    close();
+    // A swap cut short leaves files with different stamps, which open() rejects
+    const bool ok = replaceFile(m_vecPath + ".tmp", m_vecPath) && replaceFile(m_idPath + ".tmp", m_idPath);
+    m_labels = LabelLog();
+    if (ok && m_stagedLabels.rows >= 0 && replaceFile(labelPath() + ".tmp", labelPath())) m_labels = m_stagedLabels;
+    if (!ok) qDebug() << "Vector sidecar could not be replaced (mapped by another process?):" << m_vecPath;
+    discardStaged();
+    return ok;
+}
+
+void VectorFile::discardStaged() {
+    QFile::remove(m_vecPath + ".tmp");
+    QFile::remove(m_idPath + ".tmp");
+    QFile::remove(labelPath() + ".tmp");
+    m_stagedLabels = LabelLog();
+}
+
+bool VectorFile::append(const VectorMatrix& matrix, int row) {
+    if (row != m_rows || matrix.dimension() <= 0) return false; // Files no longer mirror the matrix
+
+    const qint64 recordBytes = (qint64)matrix.stride() * sizeof(float);
+    if (!m_vecOut.isOpen()) {
+        if (m_rows == 0) {
+            // Start over on fresh files rather than overwriting pages another process may map;
+            // where the old ones can't go yet (Windows, still mapped) the row is just not mirrored
+            if ((QFile::exists(m_vecPath) && !QFile::remove(m_vecPath))
+                || (QFile::exists(m_idPath) && !QFile::remove(m_idPath))) {
+                return false;
+            }
+        }
+        m_vecOut.setFileName(m_vecPath);
+        m_idOut.setFileName(m_idPath);
+        if (!m_vecOut.open(QIODevice::ReadWrite) || !m_idOut.open(QIODevice::ReadWrite)) {
+            m_vecOut.close();
+            m_idOut.close();
+            return false;
+        }
+        bool ok;
+        if (m_rows == 0) {
+            m_stamp = newStamp();
+            ok = writeHeaders(m_vecOut, m_idOut, matrix, m_stamp);
+        } else {
+            // Cut any torn tail so the new rows land on record boundaries
+            ok = m_vecOut.resize((qint64)sizeof(VecHeader) + m_rows * recordBytes)
+                && m_idOut.resize((qint64)sizeof(VidHeader) + (qint64)m_rows * sizeof(qint32))
+                && m_vecOut.seek(m_vecOut.size()) && m_idOut.seek(m_idOut.size());
+        }
+        if (!ok) {
+            m_vecOut.close();
+            m_idOut.close();
+            return false;
+        }
+    }
+
+    const qint32 id = matrix.idAt(row);
+    if (m_vecOut.write(reinterpret_cast<const char*>(matrix.row(row)), recordBytes) != recordBytes
+        || m_idOut.write(reinterpret_cast<const char*>(&id), sizeof(id)) != sizeof(id)
+        || !m_vecOut.flush() || !m_idOut.flush()) {
+        return false;
+    }
+    m_rows++;
+    return true;
+}
+
+void VectorFile::remove() {
+    close();
+    QFile::remove(m_vecPath);
+    QFile::remove(m_idPath);
+    QFile::remove(labelPath());
+    m_stamp = 0;
+    m_labels = LabelLog();
+}
+
+bool VectorFile::writeLabelLog(const QString& path, qint64 stamp, const RowLabels& labels, const BinaryMatrix& bits,
+                               int rows, const RowBitmap* deleted, LabelLog& log) {
+    if (labels.size() < rows || bits.rows() < rows) return false;
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) return false;
+
+    const VlbHeader header = {kVlbMagic, kVectorFileVersion, bits.words(), 0, stamp};
+    bool ok = file.write(reinterpret_cast<const char*>(&header), sizeof(header)) == sizeof(header);
+    QByteArray buffer;
+    auto flush = [&](int threshold) {
+        if (ok && buffer.size() >= threshold) {
+            ok = file.write(buffer) == buffer.size();
+            buffer.clear();
+        }
+    };
+    for (int k = 0; k < RowLabels::KindCount; ++k) {
+        for (const QString& name : labels.names[k]) putName(buffer, k, name);
+    }
+    for (int r = 0; r < rows; ++r) {
+        putRow(buffer, labels, bits, r);
+        flush(kLabelFlushBytes);
+    }
+    if (deleted) deleted->forEach(0, rows, [&](int r) { putDeleted(buffer, r); });
+    flush(0);
+    if (!ok) return false;
+
+    log.stamp = stamp;
+    log.rows = rows;
+    for (int k = 0; k < RowLabels::KindCount; ++k) log.names[k] = labels.names[k].size();
+    log.bytes = file.size();
+    return true;
+}
+
+bool VectorFile::openLabels(RowLabels& labels, BinaryMatrix& bits, RowBitmap& deleted) {
+    labels.clear();
+    bits.reset(m_dim);
+    deleted = RowBitmap();
+    m_labelOut.close();
+    m_labels = LabelLog();
+    if (m_dim <= 0) return false;
+
+    QFile file(labelPath());
+    VlbHeader header;
+    if (!file.open(QIODevice::ReadOnly) || file.read(reinterpret_cast<char*>(&header), sizeof(header)) != sizeof(header)
+        || header.magic != kVlbMagic || header.version != kVectorFileVersion || header.stamp != m_stamp
+        || header.words != bits.words()) {
+        return false;
+    }
+
+    // One sequential read; entries cut off by a torn append end the log
+    const QByteArray data = file.readAll();
+    const char* p = data.constData();
+    const char* const end = p + data.size();
+    const int recordBytes = 4 * sizeof(qint32) + bits.words() * sizeof(uint64_t);
+    const char* valid = p;
+    while (p < end) {
+        const char tag = *p++;
+        if (tag == kNameEntry) {
+            quint32 bytes;
+            if (end - p < 1 + (qint64)sizeof(bytes)) break;
+            const int kind = uchar(*p++);
+            memcpy(&bytes, p, sizeof(bytes));
+            p += sizeof(bytes);
+            if (kind >= RowLabels::KindCount || end - p < (qint64)bytes) break;
+            const int before = labels.names[kind].size();
+            if (labels.intern(RowLabels::Kind(kind), QString::fromUtf8(p, bytes)) != before) return false; // Duplicate name
+            p += bytes;
+        } else if (tag == kRowEntry) {
+            if (end - p < recordBytes) break;
+            qint32 record[4];
+            memcpy(record, p, sizeof(record));
+            for (int k = 0; k < RowLabels::KindCount; ++k) {
+                // Names precede the rows using them; a placeholder row has no labels at all
+                if (record[k] >= labels.names[k].size() || (record[k] < 0) != (record[0] < 0)) return false;
+            }
+            labels.doc.append(record[0]);
+            labels.type.append(record[1]);
+            labels.heading.append(record[2]);
+            labels.level.append(record[3]);
+            bits.appendSketch(reinterpret_cast<const uint64_t*>(p + sizeof(record)));
+            p += recordBytes;
+        } else if (tag == kDeletedEntry) {
+            qint32 row;
+            if (end - p < (qint64)sizeof(row)) break;
+            memcpy(&row, p, sizeof(row));
+            p += sizeof(row);
+            if (row < 0 || row >= labels.size()) return false;
+            deleted.set(row);
+        } else {
+            break;
+        }
+        valid = p;
+    }
+
+    // A row appended to the pair but not to the log (torn) leaves it one behind: unusable
+    if (labels.size() != m_rows) return false;
+    for (int r = 0; r < m_rows; ++r) {
+        if (labels.doc[r] < 0) deleted.set(r); // Placeholder of a row gone before the log was written
+    }
+    deleted.resize(m_rows);
+
+    m_labels.stamp = m_stamp;
+    m_labels.rows = m_rows;
+    for (int k = 0; k < RowLabels::KindCount; ++k) m_labels.names[k] = labels.names[k].size();
+    m_labels.bytes = sizeof(header) + (valid - data.constData());
+    return true;
+}
+
+bool VectorFile::writeLabels(const RowLabels& labels, const BinaryMatrix& bits, const RowBitmap& deleted) {
+    m_labelOut.close();
+    m_labels = LabelLog();
+    LabelLog log;
+    const QString staged = labelPath() + ".tmp";
+    if (m_stamp == 0 || !writeLabelLog(staged, m_stamp, labels, bits, m_rows, &deleted, log)
+        || !replaceFile(staged, labelPath())) {
+        QFile::remove(staged);
+        return false;
+    }
+    m_labels = log;
+    return true;
+}
+
+bool VectorFile::appendLabelEntry(const QByteArray& entry) {
+    if (!m_labelOut.isOpen()) {
+        m_labelOut.setFileName(labelPath());
+        // Cut any torn tail so the entry lands right after the last complete one
+        if (!m_labelOut.open(QIODevice::ReadWrite) || !m_labelOut.resize(m_labels.bytes) || !m_labelOut.seek(m_labels.bytes)) {
+            m_labelOut.close();
+            m_labels = LabelLog();
+            return false;
+        }
+    }
+    if (m_labelOut.write(entry) != entry.size() || !m_labelOut.flush()) {
+        m_labelOut.close();
+        m_labels = LabelLog(); // Stops mirroring; the next open rebuilds the log
+        return false;
+    }
+    m_labels.bytes += entry.size();
+    return true;
+}
+
+bool VectorFile::appendLabels(const RowLabels& labels, const BinaryMatrix& bits, int row) {
+    if (row >= labels.size() || row >= bits.rows()) return false;
+    if (m_labels.stamp != m_stamp || m_labels.rows < 0) {
+        // The first row of fresh files starts a fresh log; otherwise the log can't catch up
+        if (row != 0 || m_rows != 1) return false;
+        m_labelOut.close();
+        LabelLog log;
+        if (!writeLabelLog(labelPath(), m_stamp, labels, bits, 1, nullptr, log)) return false;
+        m_labels = log;
+        return true;
+    }
+    if (row != m_labels.rows) return false;
+
+    QByteArray entry;
+    for (int k = 0; k < RowLabels::KindCount; ++k) {
+        for (int i = m_labels.names[k]; i < labels.names[k].size(); ++i) putName(entry, k, labels.names[k][i]);
+    }
+    putRow(entry, labels, bits, row);
+    if (!appendLabelEntry(entry)) return false;
+    for (int k = 0; k < RowLabels::KindCount; ++k) m_labels.names[k] = labels.names[k].size();
+    m_labels.rows++;
+    return true;
+}
+
+bool VectorFile::appendDeleted(int row) {
+    if (m_labels.stamp != m_stamp || row < 0 || row >= m_labels.rows) return false;
+    QByteArray entry;
+    putDeleted(entry, row);
+    return appendLabelEntry(entry);
+}
@@ -0,0 +1,95 @@
+#ifndef VECTOR_FILE_H
+#define VECTOR_FILE_H
+
+#include <QFile>
+#include <QString>
+#include <QVector>
+#include "vector_matrix.h"
+#include "binary_matrix.h"
+#include "row_bitmap.h"
+#include "row_labels.h"
+
+// Flat on-disk copy of the resident matrix, kept next to the workspace database:
+//   <workspace>.vec  64-byte header, then unit-length float rows padded to the matrix stride
+//   <workspace>.vid  16-byte header, then the SQLite id of each row (int32)
+// Both files are append-only and in row order. The .vec file is mapped read-only, so a
+// workspace opens without decoding any blob and every process shares the same pages.
+// A torn append is harmless: only rows present in both files count. Rewrites go to new
+// files that replace the old ones; on Windows that fails while another process maps them,
+// and the store then runs from memory until the next open rebuilds the sidecar.
+//
+// A third file carries what else a row needs at open, so a mapped open reads no table rows
+// and touches no mapped page:
+//   <workspace>.vlb  24-byte header, then an append-only log of entries: a new interned
+//                    name, a row (doc/type/heading ordinals, heading level, 1-bit sketch)
+//                    or a deletion. Rewritten compactly with the other two files.
+// It is stamped like them and only used while its stamp matches the mapped pair.
+class VectorFile {
+public:
+    VectorFile() = default;
+    ~VectorFile();
+    VectorFile(const VectorFile&) = delete;
+    VectorFile& operator=(const VectorFile&) = delete;
+
+    void setPaths(const QString& vecPath, const QString& idPath);
+
+    // Maps the existing files; false if missing, malformed or of another dimension
+    bool open(int dim);
+    void close(); // Unmaps; any matrix attached to data() must be cleared first
+
+    int rows() const { return m_rows; } // Mapped + appended since open/write
+    const float* data() const { return m_data; }
+    const QVector<int>& ids() const { return m_ids; } // Of the mapped rows
+
+    // Rewrites the files from the matrix (and the labels log, when given); leaves them unmapped
+    bool write(const VectorMatrix& matrix, const RowLabels* labels = nullptr, const BinaryMatrix* bits = nullptr);
+    // write() in two steps: stage() builds the new files beside the live ones (safe while
+    // they are mapped and appended to), commitStaged() swaps them in (false if the live
+    // files could not be replaced; they are left as they were)
+    bool stage(const VectorMatrix& matrix, const RowLabels* labels = nullptr, const BinaryMatrix* bits = nullptr);
+    bool commitStaged();
+    void discardStaged();
+    // Appends matrix row `row`, creating the files when they don't exist yet
+    bool append(const VectorMatrix& matrix, int row);
+    void remove(); // Closes and deletes all three files
+
+    // Labels log of the mapped rows, after open(); false unless it describes every one of them
+    bool openLabels(RowLabels& labels, BinaryMatrix& bits, RowBitmap& deleted);
+    // Rewrites the log alone for the mapped pair (labels/bits cover every mapped row)
+    bool writeLabels(const RowLabels& labels, const BinaryMatrix& bits, const RowBitmap& deleted);
+    // Mirrors row `row` (just appended to the files) and any names interned since the last call
+    bool appendLabels(const RowLabels& labels, const BinaryMatrix& bits, int row);
+    bool appendDeleted(int row);
+
+private:
+    // What the log on disk holds, so appends can continue it
+    struct LabelLog {
+        qint64 stamp = 0;
+        int rows = -1; // -1 = no usable log
+        int names[RowLabels::KindCount] = {0, 0, 0};
+        qint64 bytes = 0;
+    };
+
+    bool writeHeaders(QFile& vec, QFile& ids, const VectorMatrix& matrix, qint64 stamp);
+    static bool writeLabelLog(const QString& path, qint64 stamp, const RowLabels& labels, const BinaryMatrix& bits,
+                              int rows, const RowBitmap* deleted, LabelLog& log);
+    bool appendLabelEntry(const QByteArray& entry);
+    QString labelPath() const;
+
+    QString m_vecPath;
+    QString m_idPath;
+    QFile m_mapped;
+    uchar* m_map = nullptr;
+    const float* m_data = nullptr;
+    QVector<int> m_ids;
+    int m_rows = 0;
+    QFile m_vecOut; // Append handles, opened on first append
+    QFile m_idOut;
+    int m_dim = 0;
+    qint64 m_stamp = 0; // Of the mapped pair (or of the files append() started)
+    LabelLog m_labels;
+    LabelLog m_stagedLabels;
+    QFile m_labelOut;
+};
+
+#endif // VECTOR_FILE_H
@@ -0,0 +1,47 @@
+#ifndef VECTOR_INDEX_H
+#define VECTOR_INDEX_H
+
+#include <QString>
+#include <QVector>
+#include <memory>
+#include "vector_matrix.h"
+#include "top_k.h"
+#include "row_bitmap.h"
+
+// Per-query knobs forwarded from SearchOptions to whichever index serves the query.
+// Zero means "use the index's configured default".
+struct IndexQuery {
+    int k = 10;
+    int efSearch = 0;   // HNSW
+    int nprobe = 0;     // IVF
+    const RowBitmap* filter = nullptr; // Only these rows may be returned (null = all)
+};
+
+// Strategy Pattern Interface for approximate nearest-neighbour structures.
+// Indexes address vectors by row ordinal in the store's resident VectorMatrix and read
+// the vectors from it; they only own their auxiliary structure (graph, lists, codes).
+// Rows are unit length, so similarity is a plain dot product (higher is better).
+class IVectorIndex {
+public:
+    virtual ~IVectorIndex() = default;
+
+    virtual QString name() const = 0;
+    virtual int size() const = 0; // Number of matrix rows covered, always a prefix [0, size)
+
+    // Incremental maintenance: row must equal size()
+    virtual void add(const VectorMatrix& matrix, int row) = 0;
+    virtual void clear() = 0;
+
+    virtual QVector<ScoredRow> search(const VectorMatrix& matrix, const float* query, const IndexQuery& params) const = 0;
+
+    // Copy of this index for a compacted matrix: old row r becomes remap[r], or is dropped
+    // when remap[r] < 0 (rows past remap.size() are dropped too; the caller re-adds them).
+    // remap is ascending over the kept rows and `matrix` already holds the compacted rows.
+    virtual std::unique_ptr<IVectorIndex> compacted(const VectorMatrix& matrix, const QVector<int>& remap) const = 0;
+
+    // Sidecar persistence next to the workspace database
+    virtual bool save(const QString& path) const = 0;
+    virtual bool load(const QString& path) = 0;
+};
+
+#endif // VECTOR_INDEX_H
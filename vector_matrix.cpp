@@ -0,0 +1,103 @@
+#include "vector_matrix.h"
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <utility>
+
+VectorMatrix::~VectorMatrix() {
+    std::free(m_raw);
+}
+
+void VectorMatrix::reset(int dim) {
+    clear();
+    m_dim = dim;
+    m_stride = ((dim + kFloatsPerLine - 1) / kFloatsPerLine) * kFloatsPerLine;
+}
+
+void VectorMatrix::clear() {
+    std::free(m_raw);
+    m_raw = nullptr;
+    m_data = nullptr;
+    m_ext = nullptr;
+    m_extRows = 0;
+    m_dim = 0;
+    m_stride = 0;
+    m_rows = 0;
+    m_capacity = 0;
+    m_ids.clear();
+}
+
+void VectorMatrix::reserve(int rows) {
+    if (rows - m_extRows > m_capacity) grow(rows - m_extRows);
+    m_ids.reserve(rows);
+}
+
+int VectorMatrix::append(int id, const float* vec) {
+    if (m_dim <= 0) return -1;
+    const int owned = m_rows - m_extRows;
+    if (owned == m_capacity) grow(qMax(64, m_capacity * 2));
+    if (owned == m_capacity) return -1; // Allocation failed
+
+    float* dst = m_data + (size_t)owned * m_stride;
+    memcpy(dst, vec, m_dim * sizeof(float));
+    if (m_stride > m_dim) memset(dst + m_dim, 0, (m_stride - m_dim) * sizeof(float));
+
+    m_ids.append(id);
+    return m_rows++;
+}
+
+void VectorMatrix::attach(const float* rows, const QVector<int>& ids) {
+    std::free(m_raw);
+    m_raw = nullptr;
+    m_data = nullptr;
+    m_capacity = 0;
+    m_ext = rows;
+    m_extRows = ids.size();
+    m_rows = ids.size();
+    m_ids = ids;
+}
+
+void VectorMatrix::shareRows(const float* rows, int count) {
+    if (m_extRows > 0 || count <= 0 || count > m_rows) return;
+    const int tail = m_rows - count;
+    void* raw = nullptr;
+    float* aligned = nullptr;
+    if (tail > 0) {
+        raw = std::malloc((size_t)tail * m_stride * sizeof(float) + kAlignment);
+        if (!raw) return; // Keep the heap copy
+        aligned = reinterpret_cast<float*>((reinterpret_cast<uintptr_t>(raw) + kAlignment - 1) & ~(uintptr_t)(kAlignment - 1));
+        memcpy(aligned, m_data + (size_t)count * m_stride, (size_t)tail * m_stride * sizeof(float));
+    }
+    std::free(m_raw);
+    m_raw = raw;
+    m_data = aligned;
+    m_capacity = tail;
+    m_ext = rows;
+    m_extRows = count;
+}
+
+void VectorMatrix::swap(VectorMatrix& other) {
+    std::swap(m_ext, other.m_ext);
+    std::swap(m_extRows, other.m_extRows);
+    std::swap(m_data, other.m_data);
+    std::swap(m_raw, other.m_raw);
+    std::swap(m_dim, other.m_dim);
+    std::swap(m_stride, other.m_stride);
+    std::swap(m_rows, other.m_rows);
+    std::swap(m_capacity, other.m_capacity);
+    m_ids.swap(other.m_ids);
+}
+
+void VectorMatrix::grow(int minRows) {
+    // Over-allocate by one line and align manually; portable across MSVC and GCC
+    size_t bytes = (size_t)minRows * m_stride * sizeof(float) + kAlignment;
+    void* raw = std::malloc(bytes);
+    if (!raw) return;
+    float* aligned = reinterpret_cast<float*>((reinterpret_cast<uintptr_t>(raw) + kAlignment - 1) & ~(uintptr_t)(kAlignment - 1));
+
+    if (m_rows > m_extRows) memcpy(aligned, m_data, (size_t)(m_rows - m_extRows) * m_stride * sizeof(float));
+    std::free(m_raw);
+    m_raw = raw;
+    m_data = aligned;
+    m_capacity = minRows;
+}
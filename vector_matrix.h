@@ -0,0 +1,61 @@
+#ifndef VECTOR_MATRIX_H
+#define VECTOR_MATRIX_H
+
+#include <QVector>
+
+// Resident, row-major float matrix holding every embedding of a workspace.
+// Each row starts on a 64-byte boundary (stride padded to 16 floats, tail zeroed)
+// so scan kernels can stream the whole block without touching SQLite.
+// A prefix of rows may live in an external read-only block (the mapped .vec sidecar);
+// rows appended after it go to the owned heap block.
+class VectorMatrix {
+public:
+    static constexpr int kAlignment = 64;
+    static constexpr int kFloatsPerLine = kAlignment / sizeof(float);
+
+    VectorMatrix() = default;
+    ~VectorMatrix();
+    VectorMatrix(const VectorMatrix&) = delete;
+    VectorMatrix& operator=(const VectorMatrix&) = delete;
+
+    void reset(int dim);      // Drops all rows and fixes the row width
+    void clear();             // Drops all rows and the dimension
+    void reserve(int rows);
+    int append(int id, const float* vec); // Returns the row ordinal
+
+    // Serves rows [0, ids.size()) from `rows`, laid out with this matrix's stride and
+    // 64-byte aligned; drops any owned rows. The block must outlive its use here.
+    void attach(const float* rows, const QVector<int>& ids);
+    // Re-points the first `count` owned rows at an external block holding the same data
+    // (e.g. just written to the sidecar) and frees their heap copy; later rows stay owned
+    void shareRows(const float* rows, int count);
+    int attachedRows() const { return m_extRows; }
+
+    void swap(VectorMatrix& other);
+
+    int dimension() const { return m_dim; }
+    int stride() const { return m_stride; }
+    int rows() const { return m_rows; }
+    bool isEmpty() const { return m_rows == 0; }
+
+    const float* row(int r) const {
+        return r < m_extRows ? m_ext + (size_t)r * m_stride : m_data + (size_t)(r - m_extRows) * m_stride;
+    }
+    int idAt(int r) const { return m_ids[r]; }
+    const QVector<int>& ids() const { return m_ids; }
+
+private:
+    void grow(int minRows);
+
+    const float* m_ext = nullptr; // External prefix (not owned)
+    int m_extRows = 0;
+    float* m_data = nullptr;  // Owned rows after the prefix
+    void* m_raw = nullptr;    // Unaligned allocation backing m_data
+    int m_dim = 0;
+    int m_stride = 0;
+    int m_rows = 0;
+    int m_capacity = 0;       // Owned rows allocated
+    QVector<int> m_ids;       // Parallel to rows: SQLite rowid of each embedding
+};
+
+#endif // VECTOR_MATRIX_H
@@ -1,13 +1,18 @@
 #include "vector_store.h"
+#include "simd_kernels.h"
+#include "top_k.h"
+#include "mmr_selector.h"
 #include <QSqlQuery>
 #include <QRegularExpression>
 #include <QMessageBox>
 #include <QHeaderView>
 #include <QVariant>
+#include <QSet>
 #include <QDebug>
 #include <QCoreApplication>
 #include <QSqlError>
 #include <QFile>
+#include <QFileInfo>
 #include <QDir>
 #include <QTextStream>
 #include <QtMath>
@@ -15,25 +20,222 @@
 #include <QElapsedTimer>
 #include <algorithm>
 #include <cstdlib>
+#include <cstring>
 
 #include <QtConcurrent>
 #include <QFuture>
 
+namespace {
+
+// Rows of scan data per shard (~L2-sized), floored so tiny rows don't produce thousands of tasks
+const int kShardBytes = 1 << 20;
+const int kMinShardRows = 512;
+
+// searchBatch tiling: corpus block kept hot in L2, up to 4 x kBatchTileGroups queries per task
+const int kBatchBlockBytes = 256 * 1024;
+const int kBatchTileGroups = 4;
+
+// Filtered searches matching at most this many rows skip the approximate tiers: an exact
+// scan of the survivors costs about as much as a graph walk and cannot miss any of them
+const int kFilteredExactRows = 8192;
+
+// The int8 tier engages only above this many candidate rows. Below it the exact float scan
+// takes a few milliseconds, so a small workspace keeps exact scores by default
+const int kSq8MinRows = 50000;
+
+// Exact linear scan split into shards scored in parallel on the pool, each into a private
+// TopK, then merged in shard order. TopK orders by (score, row) and rows follow id order,
+// so the result is identical to a serial scan regardless of scheduling. Rows outside
+// `allowed` (when given) are never scored.
+template <typename ScoreFn>
+TopK shardedScan(QThreadPool* pool, int rows, int k, int rowBytes, const RowBitmap* allowed, const ScoreFn& score) {
+    auto scanRange = [&](TopK& topK, int begin, int end) {
+        if (!allowed) {
+            for (int r = begin; r < end; ++r) topK.push(r, score(r));
+        } else {
+            allowed->forEach(begin, end, [&](int r) { topK.push(r, score(r)); });
+        }
+    };
+
+    const int shardRows = qMax(kMinShardRows, kShardBytes / qMax(1, rowBytes));
+    const int shards = (rows + shardRows - 1) / shardRows;
+    TopK merged(k);
+    if (shards <= 1 || pool->maxThreadCount() < 2) {
+        scanRange(merged, 0, rows);
+        return merged;
+    }
+
+    QVector<TopK> partial(shards, TopK(k));
+    TopK* parts = partial.data();
+    QVector<int> shardIndex(shards);
+    for (int s = 0; s < shards; ++s) shardIndex[s] = s;
+    QtConcurrent::blockingMap(pool, shardIndex, [&](int s) {
+        scanRange(parts[s], s * shardRows, qMin(rows, (s + 1) * shardRows));
+    });
+    for (const TopK& part : partial) merged.merge(part);
+    return merged;
+}
+
+// SQL form of a SearchFilter as " AND ..." terms with positional binds. The doc/type terms
+// are optional because search() answers them from the resident posting bitmaps instead.
+QString filterClause(const SearchFilter& filter, bool withPostings, QVariantList& binds) {
+    QString clause;
+    auto inList = [&](const QString& column, const QStringList& values) {
+        QStringList marks;
+        for (const QString& v : values) {
+            marks << "?";
+            binds << v;
+        }
+        clause += QString(" AND %1 IN (%2)").arg(column, marks.join(","));
+    };
+    if (withPostings && !filter.docIds.isEmpty()) inList("doc_id", filter.docIds);
+    if (withPostings && !filter.chunkTypes.isEmpty()) inList("chunk_type", filter.chunkTypes);
+    if (!filter.headingPath.isEmpty()) {
+        // Nested headings are stored as "Parent > Child" (see PdfProcessor)
+        QString escaped = filter.headingPath;
+        escaped.replace("\\", "\\\\").replace("%", "\\%").replace("_", "\\_");
+        clause += " AND (heading_path = ? OR heading_path LIKE ? ESCAPE '\\')";
+        binds << filter.headingPath << escaped + " > %";
+    }
+    if (filter.minPage > 0) {
+        clause += " AND page_num >= ?";
+        binds << filter.minPage;
+    }
+    if (filter.maxPage > 0) {
+        clause += " AND page_num <= ?";
+        binds << filter.maxPage;
+    }
+    return clause;
+}
+
+struct FtsTable {
+    const char* name;
+    const char* rank;
+};
+// Word index over every row. BM25 column weights (heading_path, text_chunk): a term in the
+// short heading field says more about the chunk's topic than the same term in its body.
+const FtsTable kWordFts = {"embeddings_fts", "bm25(2.0, 1.0)"};
+// Trigram index over code/table chunks only: substring match, so identifiers and literals
+// the word tokenizer splits apart (std::vector, 0x7fff, push_back) stay one lookup
+const FtsTable kCodeFts = {"embeddings_code_fts", "bm25()"};
+
+bool isCodeChunk(const QString& chunkType) {
+    return chunkType == "code" || chunkType == "table";
+}
+
+struct KeywordHit {
+    int id;
+    double score; // BM25, higher = better (FTS5 reports it negated)
+};
+
+// FTS candidates best-first by BM25. ORDER BY rank lets FTS5 sort its own matches and keep
+// only the top `limit`; the filter terms join back to embeddings before that cut.
+QVector<KeywordHit> keywordHits(const QSqlDatabase& db, const QString& queryText, int limit, const SearchFilter& filter,
+                                const FtsTable& table = kWordFts) {
+    QVariantList binds{queryText, table.rank};
+    QString clause = filterClause(filter, true, binds);
+    binds << limit;
+    QSqlQuery q(db);
+    q.setForwardOnly(true);
+    QString sql = QString("SELECT rowid, rank FROM %1 WHERE %1 MATCH ? AND rank MATCH ?").arg(table.name);
+    if (!clause.isEmpty()) sql += " AND rowid IN (SELECT id FROM embeddings WHERE 1 = 1" + clause + ")";
+    q.prepare(sql + " ORDER BY rank LIMIT ?");
+    for (const QVariant& v : binds) q.addBindValue(v);
+
+    QVector<KeywordHit> hits;
+    if (q.exec()) {
+        while (q.next()) hits.append({q.value(0).toInt(), -q.value(1).toDouble()});
+    } else {
+        qDebug() << "FTS query failed:" << q.lastError().text();
+    }
+    return hits;
+}
+
+// Identifier-shaped tokens of a query: scope/member access (std::vector, ptr->next,
+// obj.method), calls, hex literals, snake_case / camelCase names, subscripts, templates and
+// preprocessor directives. Member access wants two characters a side, so abbreviations
+// (e.g., U.S.) stay prose, and a trailing '#' or '+' (C#, C++) is not a code shape.
+// Tokens under three characters cannot hit a trigram index and are dropped.
+QStringList codeIdentifiers(const QString& queryText) {
+    static const QRegularExpression codeShape("::|->|[A-Za-z_]\\w\\.[A-Za-z_]\\w|[A-Za-z_]\\w\\(|^0[xX][0-9a-fA-F]+$"
+                                              "|[A-Za-z0-9]_[A-Za-z0-9]|^[a-z]{2,}[A-Z]|\\w\\[|\\w<\\w|^#[a-z]+$");
+    static const QRegularExpression edges("^[\"'`(]+|[\"'`,;:!?]+$|\\.$");
+    QStringList tokens;
+    for (QString piece : queryText.split(QRegularExpression("\\s+"), Qt::SkipEmptyParts)) {
+        piece.remove(edges); // Quotes and sentence punctuation around the token
+        if (!piece.contains("(") && piece.endsWith(")")) piece.chop(1);
+        if (piece.endsWith("()")) piece.chop(2);
+        else if (!piece.contains(codeShape)) continue;
+        if (piece.size() >= 3 && !tokens.contains(piece)) tokens << piece;
+    }
+    return tokens;
+}
+
+// Trigram MATCH for a code query: each identifier as a quoted substring, OR'd so a chunk
+// holding any of them matches; bm25() ranks the ones holding more (and rarer) of them first
+QString codeMatch(const QStringList& identifiers) {
+    QStringList phrases;
+    for (QString token : identifiers) phrases << "\"" + token.replace("\"", "\"\"") + "\"";
+    return phrases.join(" OR ");
+}
+
+// Code-table hits first (an exact substring hit is the strongest keyword evidence), then
+// the word hits they don't already hold, up to `limit`
+QVector<KeywordHit> mergeKeywordHits(QVector<KeywordHit> first, const QVector<KeywordHit>& rest, int limit) {
+    QSet<int> seen;
+    for (const KeywordHit& hit : first) seen.insert(hit.id);
+    for (const KeywordHit& hit : rest) {
+        if (first.size() >= limit) break;
+        if (!seen.contains(hit.id)) first.append(hit);
+    }
+    if (first.size() > limit) first.resize(limit);
+    return first;
+}
+
+// Deleted rows stay in the resident tiers as tombstones; past this share a background
+// compaction drops them (every scan still pays for the dead rows it skips)
+const double kCompactDeadFraction = 0.2;
+
+// IVF training sample bound. The default nlist x samplesPerList is ~256k rows at a million
+// rows, 3 GB at 3072 dims; a quarter of that still leaves every list 16 points
+const qint64 kIvfSampleBytes = qint64(768) << 20;
+
+} // namespace
+
 VectorStore::VectorStore(const QString& dbPath, QObject *parent) 
     : QObject(parent), m_dbPath(dbPath) {
+    // Several stores can be open at once (federated search), so each owns its connection names
+    static QAtomicInt instances;
+    m_connectionName = QString("VectorDBConnection_%1").arg(instances.fetchAndAddRelaxed(1));
     m_threadPool = new QThreadPool(this);
-    m_threadPool->setMaxThreadCount(qMax(2, QThread::idealThreadCount() / 2));
+    m_threadPool->setMaxThreadCount(qMax(2, QThread::idealThreadCount())); // Sharded scans use every core
     m_queryCache.setMaxCost(100); // Store 100 recent query results
+    m_avgLatency.storeRelaxed(100); // Seed with 100ms
+    qDebug() << "Similarity kernels:" << SimdKernels::levelName();
 }
 
 VectorStore::~VectorStore() {
+    cancelIndexTraining();
+    saveAnnIndex();
     if (m_db.isOpen()) {
         m_db.close();
     }
 }
 
+QSqlDatabase VectorStore::connection() const {
+    if (QThread::currentThread() == thread()) return m_db;
+
+    // QtSql connections are per-thread: pool workers get a clone of their own, named after
+    // this store so two open workspaces never share one
+    const QString name = QString("%1_Thread_%2").arg(m_connectionName).arg(reinterpret_cast<uintptr_t>(QThread::currentThreadId()));
+    if (QSqlDatabase::contains(name)) return QSqlDatabase::database(name);
+    QSqlDatabase db = QSqlDatabase::cloneDatabase(m_db, name);
+    db.open();
+    return db;
+}
+
 bool VectorStore::init() {
-    QString connectionName = "VectorDBConnection";
+    QString connectionName = m_connectionName;
     if (QSqlDatabase::contains(connectionName)) {
         m_db = QSqlDatabase::database(connectionName);
     } else {
@@ -147,6 +349,1025 @@ bool VectorStore::init() {
         qDebug() << "Migrated database to v15 (Rank Stability Signals).";
     }
 
+    // Migration to v16: Pre-normalized embeddings (cosine reduces to a dot product)
+    if (version < 16) {
+        q.exec("ALTER TABLE embeddings ADD COLUMN vector_norm REAL");
+        int migrated = normalizeStoredVectors();
+        q.exec("PRAGMA user_version = 16");
+        qDebug() << "Migrated database to v16 (Pre-normalized Embeddings," << migrated << "rows).";
+    }
+
+    // Migration to v17: Product-quantized codes alongside the float vectors
+    if (version < 17) {
+        q.exec("ALTER TABLE embeddings ADD COLUMN pq_codes BLOB");
+        q.exec("CREATE TABLE IF NOT EXISTS pq_codebook ("
+               "id INTEGER PRIMARY KEY CHECK (id = 1), "
+               "codebook BLOB, "
+               "trained_at DATETIME DEFAULT CURRENT_TIMESTAMP)");
+        q.exec("PRAGMA user_version = 17");
+        qDebug() << "Migrated database to v17 (Product Quantization).";
+    }
+
+    // Migration to v18: Int8 scalar-quantized copy of every embedding
+    if (version < 18) {
+        q.exec("ALTER TABLE embeddings ADD COLUMN sq8_blob BLOB");
+        int migrated = quantizeStoredVectors();
+        q.exec("PRAGMA user_version = 18");
+        qDebug() << "Migrated database to v18 (Int8 Scalar Quantization," << migrated << "rows).";
+    }
+
+    // Migration to v19: Versioned vector blobs. Existing rows stay float32 (converting is an
+    // explicit setVectorStorageType() call); a workspace created empty starts out as fp16
+    if (version < 19) {
+        QSqlQuery rows("SELECT 1 FROM embeddings LIMIT 1", m_db);
+        const VectorBlob::Type type = rows.next() ? VectorBlob::Type::Float32 : VectorBlob::Type::Float16;
+        setMetadata("vector_dtype", VectorBlob::typeName(type));
+        q.exec("PRAGMA user_version = 19");
+        qDebug() << "Migrated database to v19 (Versioned Vector Blobs," << VectorBlob::typeName(type) << ").";
+    }
+    // Migration to v20: Reduced-dimension (PCA) copy of every embedding
+    if (version < 20) {
+        q.exec("ALTER TABLE embeddings ADD COLUMN pca_blob BLOB");
+        q.exec("PRAGMA user_version = 20");
+        qDebug() << "Migrated database to v20 (PCA Cascade).";
+    }
+    // Migration to v21: Heading path as its own FTS column, so BM25 can weight it.
+    // Both columns mirror embeddings, which lets FTS5 rebuild the index from the table.
+    if (version < 21) {
+        q.exec("DROP TABLE IF EXISTS embeddings_fts");
+        q.exec("CREATE VIRTUAL TABLE embeddings_fts USING fts5(heading_path, text_chunk, content='embeddings', content_rowid='id')");
+        q.exec("INSERT INTO embeddings_fts(embeddings_fts) VALUES ('rebuild')");
+        q.exec("PRAGMA user_version = 21");
+        qDebug() << "Migrated database to v21 (BM25 Keyword Ranking).";
+    }
+    // Migration to v22: Trigram FTS over code/table chunks (external content, partial: no 'rebuild')
+    if (version < 22) {
+        q.exec("CREATE VIRTUAL TABLE IF NOT EXISTS embeddings_code_fts USING fts5(text_chunk, content='embeddings', content_rowid='id', tokenize='trigram')");
+        q.exec("INSERT INTO embeddings_code_fts(rowid, text_chunk) SELECT id, text_chunk FROM embeddings WHERE chunk_type IN ('code', 'table')");
+        q.exec("PRAGMA user_version = 22");
+        qDebug() << "Migrated database to v22 (Code-aware Keyword Index).";
+    }
+    m_blobType = VectorBlob::typeFromName(getMetadata("vector_dtype"));
+
+    cancelIndexTraining();
+    QWriteLocker locker(&m_indexLock);
+    m_vectorFile.setPaths(sidecarPath("vec"), sidecarPath("vid"));
+    loadPqCodec();
+    loadPcaProjection();
+    loadMatrix();
+    loadAnnIndex();
+    m_keywordIndexEnabled = getMetadata("keyword_index") == "memory";
+    loadKeywordIndex();
+    return true;
+}
+
+QString VectorStore::sidecarPath(const QString& extension) const {
+    QFileInfo info(m_dbPath);
+    return info.absolutePath() + "/" + info.completeBaseName() + "." + extension;
+}
+
+void VectorStore::loadAnnIndex() {
+    m_annIndex.reset();
+    m_annDirty = false;
+
+    // At most one index kind is kept per workspace; installAnnIndex removes the other sidecar
+    std::unique_ptr<IVectorIndex> index;
+    QString path = sidecarPath("hnsw");
+    if (QFile::exists(path)) {
+        index = std::make_unique<HnswIndex>();
+    } else if (QFile::exists(path = sidecarPath("ivf"))) {
+        index = std::make_unique<IvfIndex>();
+    } else {
+        return;
+    }
+
+    if (!index->load(path) || index->size() > m_matrix.rows() || m_rowsRenumbered) {
+        qDebug() << "ANN sidecar unusable, rebuilding from resident matrix:" << path;
+        index->clear();
+    }
+
+    auto* ivf = dynamic_cast<IvfIndex*>(index.get());
+    if (ivf && ivf->isTrained() && ivf->dimension() != m_matrix.dimension()) {
+        qDebug() << "IVF centroids are" << ivf->dimension() << "dims, the matrix" << m_matrix.dimension() << "- retraining";
+        index = std::make_unique<IvfIndex>(ivf->params());
+        ivf = static_cast<IvfIndex*>(index.get());
+    }
+    if (ivf && !ivf->isTrained()) {
+        // Centroids were lost with the sidecar; the lists can't be rebuilt without a retrain
+        QFile::remove(path);
+        trainIvfIndex(ivf->params());
+        return;
+    }
+
+    // Catch up on rows appended since the sidecar was last written
+    int behind = m_matrix.rows() - index->size();
+    for (int r = index->size(); r < m_matrix.rows(); ++r) index->add(m_matrix, r);
+
+    m_annIndex = std::move(index);
+    m_annDirty = behind > 0;
+    qDebug() << m_annIndex->name().toUpper() << "index ready:" << m_annIndex->size() << "rows" << (behind ? QString("(%1 caught up)").arg(behind) : QString());
+}
+
+void VectorStore::saveAnnIndex() {
+    if (!m_annIndex || !m_annDirty) return;
+    if (m_annIndex->save(sidecarPath(m_annIndex->name()))) m_annDirty = false;
+    else qDebug() << "Failed to persist" << m_annIndex->name() << "index for" << m_dbPath;
+}
+
+void VectorStore::installAnnIndex(std::unique_ptr<IVectorIndex> index) {
+    if (m_annIndex && m_annIndex->name() != index->name()) QFile::remove(sidecarPath(m_annIndex->name()));
+    m_annIndex = std::move(index);
+    m_annDirty = true;
+    saveAnnIndex();
+}
+
+void VectorStore::cancelIndexTraining() {
+    m_indexGeneration.fetchAndAddOrdered(1);
+    m_trainFuture.waitForFinished();
+    m_tierFuture.waitForFinished();
+}
+
+bool VectorStore::buildHnswIndex(const HnswParams& params) {
+    if (m_trainFuture.isRunning()) return false;
+
+    const int generation = m_indexGeneration.loadAcquire();
+    m_trainFuture = QtConcurrent::run(m_threadPool, [this, params, generation]() {
+        QElapsedTimer timer;
+        timer.start();
+        auto stale = [this, generation]() { return m_indexGeneration.loadAcquire() != generation; };
+
+        // 1. Insert into a local graph in short read-locked chunks; searches keep using the
+        //    current index and addEntry only waits for one chunk
+        auto index = std::make_unique<HnswIndex>(params);
+        const int chunk = 1024;
+        for (;;) {
+            QReadLocker locker(&m_indexLock);
+            if (stale()) return;
+            const int end = qMin(m_matrix.rows(), index->size() + chunk);
+            if (index->size() == end) break;
+            for (int r = index->size(); r < end; ++r) index->add(m_matrix, r);
+        }
+
+        // 2. Swap it in, catching up on anything appended since the last chunk
+        QWriteLocker locker(&m_indexLock);
+        if (stale()) return;
+        for (int r = index->size(); r < m_matrix.rows(); ++r) index->add(m_matrix, r);
+        installAnnIndex(std::move(index));
+        qDebug() << "HNSW index built over" << m_annIndex->size() << "rows in" << timer.elapsed() << "ms";
+    });
+    return true;
+}
+
+bool VectorStore::trainIvfIndex(const IvfParams& params) {
+    if (m_trainFuture.isRunning() || m_matrix.isEmpty()) return false;
+
+    const int generation = m_indexGeneration.loadAcquire();
+    m_trainFuture = QtConcurrent::run(m_threadPool, [this, params, generation]() {
+        QElapsedTimer timer;
+        timer.start();
+        auto stale = [this, generation]() { return m_indexGeneration.loadAcquire() != generation; };
+
+        // 1. Copy an evenly spaced training sample in short read-locked chunks, capped at
+        //    kIvfSampleBytes; k-means itself runs without the lock, sharded on the pool
+        IvfParams resolved = params;
+        QVector<float> sample;
+        int rows = 0, dim = 0, sampleRows = 0;
+        {
+            QReadLocker locker(&m_indexLock);
+            rows = m_matrix.rows();
+            dim = m_matrix.dimension();
+        }
+        if (resolved.nlist <= 0) resolved.nlist = IvfIndex::recommendedLists(rows);
+        sampleRows = qMin(rows, resolved.nlist * qMax(1, resolved.samplesPerList));
+        sampleRows = (int)qMin<qint64>(sampleRows, qMax<qint64>(resolved.nlist, kIvfSampleBytes / ((qint64)dim * sizeof(float))));
+        sample.resize((size_t)sampleRows * dim);
+        for (int i = 0; i < sampleRows;) {
+            QReadLocker locker(&m_indexLock);
+            if (stale()) return;
+            for (const int end = qMin(sampleRows, i + 4096); i < end; ++i) {
+                const float* src = m_matrix.row((int)((qint64)i * rows / sampleRows)); // Compaction shares the job slot: rows only grow
+                std::copy(src, src + dim, sample.data() + (size_t)i * dim);
+            }
+        }
+
+        auto index = std::make_unique<IvfIndex>(resolved);
+        index->train(sample.constData(), sampleRows, dim, m_benchSeed, m_threadPool);
+        sample = QVector<float>();
+        if (!index->isTrained() || stale()) return;
+
+        // 2. Assign existing rows in read-locked chunks so addEntry/search aren't stalled;
+        //    each chunk's nearest-list search is sharded on the pool
+        const int chunk = 16384;
+        for (;;) {
+            QReadLocker locker(&m_indexLock);
+            if (stale()) return;
+            const int end = qMin(m_matrix.rows(), index->size() + chunk);
+            if (index->size() == end) break;
+            index->addRows(m_matrix, end, m_threadPool);
+        }
+
+        // 3. Install, catching up on anything appended since the last chunk
+        QWriteLocker locker(&m_indexLock);
+        if (stale()) return;
+        for (int r = index->size(); r < m_matrix.rows(); ++r) index->add(m_matrix, r);
+        int lists = index->listCount();
+        installAnnIndex(std::move(index));
+        qDebug() << "IVF index trained:" << m_annIndex->size() << "rows in" << lists << "lists,"
+                 << sampleRows << "samples," << timer.elapsed() << "ms";
+    });
+    return true;
+}
+
+void VectorStore::dropAnnIndex() {
+    cancelIndexTraining();
+    QWriteLocker locker(&m_indexLock);
+    if (m_annIndex) QFile::remove(sidecarPath(m_annIndex->name()));
+    m_annIndex.reset();
+    m_annDirty = false;
+}
+
+int VectorStore::normalizeStoredVectors() {
+    m_db.transaction();
+    QSqlQuery select(m_db);
+    select.setForwardOnly(true);
+    select.exec("SELECT id, vector_blob FROM embeddings WHERE vector_norm IS NULL");
+
+    QSqlQuery update(m_db);
+    update.prepare("UPDATE embeddings SET vector_blob = :blob, vector_norm = :norm WHERE id = :id");
+
+    int migrated = 0;
+    while (select.next()) {
+        QVector<float> vec = blobToVector(select.value(1).toByteArray());
+        float norm = SimdKernels::normalize(vec.data(), vec.size());
+        update.bindValue(":blob", vectorToBlob(vec));
+        update.bindValue(":norm", norm);
+        update.bindValue(":id", select.value(0).toInt());
+        if (update.exec()) migrated++;
+    }
+    m_db.commit();
+    return migrated;
+}
+
+int VectorStore::quantizeStoredVectors() {
+    m_db.transaction();
+    QSqlQuery select(m_db);
+    select.setForwardOnly(true);
+    select.exec("SELECT id, vector_blob FROM embeddings WHERE sq8_blob IS NULL");
+
+    QSqlQuery update(m_db);
+    update.prepare("UPDATE embeddings SET sq8_blob = :sq8 WHERE id = :id");
+
+    int migrated = 0;
+    QVector<int8_t> code;
+    while (select.next()) {
+        QVector<float> vec = blobToVector(select.value(1).toByteArray());
+        if (vec.isEmpty()) continue;
+        code.resize(vec.size());
+        float scale = Sq8Matrix::quantize(vec.constData(), vec.size(), code.data());
+        update.bindValue(":sq8", Sq8Matrix::toBlob(code.constData(), code.size(), scale));
+        update.bindValue(":id", select.value(0).toInt());
+        if (update.exec()) migrated++;
+    }
+    m_db.commit();
+    return migrated;
+}
+
+int VectorStore::convertStoredVectors(VectorBlob::Type type, int generation) {
+    // Short transactions by id range, so the owner thread's inserts interleave with the rewrite
+    QSqlDatabase db = connection();
+    QSqlQuery select(db);
+    select.setForwardOnly(true);
+    select.prepare("SELECT id, vector_blob FROM embeddings WHERE id > :after ORDER BY id LIMIT 1024");
+    QSqlQuery update(db);
+    update.prepare("UPDATE embeddings SET vector_blob = :blob WHERE id = :id");
+
+    int converted = 0, after = 0;
+    for (bool more = true; more && m_indexGeneration.loadAcquire() == generation;) {
+        db.transaction();
+        select.bindValue(":after", after);
+        select.exec();
+        more = false;
+        while (select.next()) {
+            more = true;
+            after = select.value(0).toInt();
+            QByteArray blob = select.value(1).toByteArray();
+            if (VectorBlob::typeOf(blob) == type && VectorBlob::dimension(blob) > 0) continue;
+            QVector<float> vec = VectorBlob::decode(blob);
+            if (vec.isEmpty()) continue;
+            update.bindValue(":blob", VectorBlob::encode(vec.constData(), vec.size(), type));
+            update.bindValue(":id", after);
+            if (update.exec()) converted++;
+        }
+        select.finish();
+        db.commit();
+    }
+    return converted;
+}
+
+bool VectorStore::setVectorStorageType(VectorBlob::Type type) {
+    if (!m_db.isOpen() || m_trainFuture.isRunning() || m_tierFuture.isRunning()) return false;
+    if (type == m_blobType) return true;
+
+    // Blobs carry their own dtype, so rows written from here on and rows not yet rewritten
+    // both decode; an interrupted conversion just leaves a mix behind
+    m_blobType = type;
+    setMetadata("vector_dtype", VectorBlob::typeName(type));
+
+    const int generation = m_indexGeneration.loadAcquire();
+    m_trainFuture = QtConcurrent::run(m_threadPool, [this, type, generation]() {
+        QElapsedTimer timer;
+        timer.start();
+        const qint64 before = storageBytes();
+        const int converted = convertStoredVectors(type, generation);
+        if (m_indexGeneration.loadAcquire() != generation) return;
+        QSqlQuery q(connection());
+        q.exec("VACUUM"); // Return the freed pages to the filesystem
+        qDebug() << "Vector storage converted to" << VectorBlob::typeName(type) << ":" << converted << "rows in"
+                 << timer.elapsed() << "ms, workspace" << before / (1 << 20) << "->" << storageBytes() / (1 << 20) << "MB";
+    });
+    return true;
+}
+
+qint64 VectorStore::storageBytes() const {
+    // The float32 .vec sidecar often outweighs the (fp16) blobs themselves
+    qint64 bytes = QFileInfo(m_dbPath).size() + QFileInfo(m_dbPath + "-wal").size();
+    for (const char* extension : {"vec", "vid", "vlb", "hnsw", "ivf"}) bytes += QFileInfo(sidecarPath(extension)).size();
+    return bytes;
+}
+
+bool VectorStore::attachVectorFile(int dim, int expected) {
+    if (dim <= 0 || expected <= 0 || !m_vectorFile.open(dim)) return false;
+
+    // Cheap staleness check: the file may still hold deleted rows (tombstoned until the next
+    // compaction) but must cover every row of the table, up to its last id
+    const QVector<int>& ids = m_vectorFile.ids();
+    QSqlQuery q("SELECT MAX(id) FROM embeddings", m_db);
+    if (ids.size() < expected || !q.next() || ids.last() < q.value(0).toInt()) {
+        qDebug() << "Vector sidecar is out of date (" << ids.size() << "of" << expected << "rows), rebuilding";
+        m_vectorFile.close();
+        return false;
+    }
+    m_matrix.reset(dim);
+    m_matrix.attach(m_vectorFile.data(), ids);
+    return true;
+}
+
+void VectorStore::loadMatrix() {
+    QElapsedTimer timer;
+    timer.start();
+    m_matrix.clear();
+    m_vectorFile.close();
+
+    int dim = getRegisteredDimension();
+    int expected = count();
+
+    // Mapped sidecar: rows are already decoded, so the pass below never touches vector_blob.
+    // With its labels log as well, the pass is skipped altogether
+    const bool hadSidecar = QFile::exists(sidecarPath("vec"));
+    bool mapped = attachVectorFile(dim, expected);
+    loadHeadingVectors();
+    const bool labelled = mapped && attachRowLabels(expected);
+
+    const int codeSize = m_pq.codeSize();
+    int skipped = 0, reencoded = 0, reprojected = 0;
+    while (!labelled) {
+        m_sq8.clear();
+        m_bits.clear();
+        m_reduced.clear();
+        m_pqCodes.clear();
+        m_docRows.clear();
+        m_typeRows.clear();
+        m_levelRows.clear();
+        m_rowLabels.clear();
+        m_rowHeading.clear();
+        m_tombstones = RowBitmap();
+        m_deadRows = 0;
+        skipped = reencoded = reprojected = 0;
+
+        QSqlQuery q(m_db);
+        q.setForwardOnly(true);
+        if (!q.exec(QString("SELECT id, %1, pq_codes, sq8_blob, pca_blob, doc_id, chunk_type, heading_level, heading_path FROM embeddings ORDER BY id")
+                    .arg(mapped ? "NULL" : "vector_blob"))) {
+            qDebug() << "Matrix load failed:" << q.lastError().text();
+            return;
+        }
+
+        QVector<int8_t> sq8Code;
+        QVector<float> vec, reduced(m_pca.outputDimension());
+
+        // Derived tiers for one row; deleted rows still in the sidecar (q == null) get
+        // placeholders so every structure stays aligned with the matrix until compaction
+        auto indexRow = [&](int row, const QSqlQuery* q) {
+            const int rowDim = m_matrix.dimension();
+            if (m_sq8.dimension() == 0) {
+                m_sq8.reset(rowDim);
+                m_sq8.reserve(expected);
+                m_bits.reset(rowDim);
+                m_bits.reserve(expected);
+                sq8Code.resize(rowDim);
+                if (m_pca.inputDimension() == rowDim) {
+                    m_reduced.reset(m_pca.outputDimension());
+                    m_reduced.reserve(expected);
+                }
+            }
+            float sq8Scale = 0.0f;
+            if (q && Sq8Matrix::fromBlob(q->value(3).toByteArray(), rowDim, sq8Code.data(), sq8Scale)) m_sq8.append(sq8Code.constData(), sq8Scale);
+            else m_sq8.append(m_matrix.row(row));
+            m_bits.append(m_matrix.row(row));
+            m_rowHeading.append(q ? m_headingSlots.value(q->value(8).toString(), -1) : -1);
+            if (!q) {
+                m_rowLabels.appendNone();
+                m_tombstones.set(row);
+                m_deadRows++;
+                if (m_reduced.dimension() > 0) {
+                    std::fill(reduced.begin(), reduced.end(), 0.0f);
+                    m_reduced.append(m_matrix.idAt(row), reduced.constData());
+                }
+                if (m_pq.isTrained() && m_pq.dimension() == rowDim) m_pqCodes.resize((row + 1) * codeSize); // Zero codes
+                return;
+            }
+            m_docRows[q->value(5).toString()].set(row);
+            m_typeRows[q->value(6).toString()].set(row);
+            m_levelRows[q->value(7).toInt()].set(row);
+            m_rowLabels.append(q->value(5).toString(), q->value(6).toString(), q->value(8).toString(), q->value(7).toInt());
+            if (m_reduced.dimension() > 0) {
+                if (!VectorBlob::decode(q->value(4).toByteArray(), reduced.data(), reduced.size())) {
+                    m_pca.project(m_matrix.row(row), reduced.data());
+                    reprojected++;
+                }
+                m_reduced.append(m_matrix.idAt(row), reduced.constData());
+            }
+            if (m_pq.isTrained() && m_pq.dimension() == rowDim) {
+                QByteArray code = q->value(2).toByteArray();
+                m_pqCodes.resize((row + 1) * codeSize);
+                if (code.size() == codeSize) {
+                    memcpy(m_pqCodes.data() + (size_t)row * codeSize, code.constData(), codeSize);
+                } else {
+                    m_pq.encode(m_matrix.row(row), m_pqCodes.data() + (size_t)row * codeSize);
+                    reencoded++;
+                }
+            }
+        };
+
+        int mappedRow = 0;
+        bool stale = false;
+        while (q.next()) {
+            int row;
+            if (mapped) {
+                const int id = q.value(0).toInt();
+                while (mappedRow < m_matrix.rows() && m_matrix.idAt(mappedRow) < id) indexRow(mappedRow++, nullptr);
+                if (mappedRow >= m_matrix.rows() || id != m_matrix.idAt(mappedRow)) {
+                    stale = true;
+                    break;
+                }
+                row = mappedRow++;
+            } else {
+                QByteArray blob = q.value(1).toByteArray();
+                int rowDim = VectorBlob::dimension(blob);
+                if (rowDim <= 0) { skipped++; continue; }
+                if (m_matrix.dimension() == 0) {
+                    m_matrix.reset(dim > 0 ? dim : rowDim);
+                    m_matrix.reserve(expected);
+                }
+                if (rowDim != m_matrix.dimension()) { skipped++; continue; } // Legacy rows from another model
+
+                vec.resize(rowDim);
+                if (!VectorBlob::decode(blob, vec.data(), rowDim)) { skipped++; continue; }
+                row = m_matrix.append(q.value(0).toInt(), vec.constData());
+                if (row < 0) continue;
+            }
+            indexRow(row, &q);
+        }
+        while (mapped && !stale && mappedRow < m_matrix.rows()) indexRow(mappedRow++, nullptr); // Deleted after the last live id
+        if (!stale) break;
+
+        // Covers the table's id range but holds different rows: fall back to decoding the blobs
+        qDebug() << "Vector sidecar does not match the table, decoding stored vectors instead";
+        m_matrix.clear();
+        m_vectorFile.close();
+        mapped = false;
+    }
+
+    // Decoding drops the rows a stale sidecar still held as deleted, so later rows moved up
+    // and an ANN sidecar built against the old layout no longer points at the right rows
+    m_rowsRenumbered = hadSidecar && !mapped;
+
+    if (!mapped) {
+        // Write the sidecar for the next open; workspaces mixing dimensions don't get one
+        if (skipped == 0 && !m_matrix.isEmpty() && m_vectorFile.write(m_matrix, &m_rowLabels, &m_bits)
+            && m_vectorFile.open(m_matrix.dimension()) && m_vectorFile.rows() == m_matrix.rows()) {
+            m_matrix.attach(m_vectorFile.data(), m_vectorFile.ids()); // Share the page cache from now on
+            mapped = true;
+        } else {
+            m_vectorFile.remove();
+        }
+    } else if (!labelled && !m_vectorFile.writeLabels(m_rowLabels, m_bits, m_tombstones)) {
+        qDebug() << "Labels log write failed, the next open scans the table again";
+    }
+
+    qDebug() << "Resident matrix loaded:" << m_matrix.rows() << "rows x" << m_matrix.dimension()
+             << "dims in" << timer.elapsed() << "ms" << (labelled ? "(mapped, labels log)" : mapped ? "(mapped)" : "")
+             << (skipped ? QString("(%1 skipped)").arg(skipped) : QString())
+             << (m_deadRows ? QString("(%1 deleted)").arg(m_deadRows) : QString());
+
+    if (m_pq.isTrained() && m_pq.dimension() != m_matrix.dimension()) {
+        qDebug() << "PQ codebook dimension mismatch, scanning full-precision vectors instead";
+        m_pq = ProductQuantizer();
+        m_pqCodes.clear();
+    } else if (reencoded > 0) {
+        qDebug() << "Encoded" << reencoded << "rows missing PQ codes";
+        persistPqCodes();
+    }
+
+    selectScoreKernel(dim > 0 ? dim : m_matrix.dimension());
+
+    if (m_pca.isTrained() && m_pca.inputDimension() != m_matrix.dimension()) {
+        qDebug() << "PCA projection dimension mismatch, cascade disabled";
+        m_pca = PcaProjection();
+        m_reduced.clear();
+    } else if (reprojected > 0) {
+        qDebug() << "Projected" << reprojected << "rows missing PCA vectors";
+        persistPcaRows();
+    }
+
+    if (labelled) loadStoredTiers();
+}
+
+bool VectorStore::attachRowLabels(int expected) {
+    m_sq8.clear();
+    m_reduced.clear();
+    m_pqCodes.clear();
+    m_docRows.clear();
+    m_typeRows.clear();
+    m_levelRows.clear();
+    m_rowHeading.clear();
+    m_tombstones = RowBitmap();
+    m_deadRows = 0;
+
+    // The log is stamped with its .vec, so only the live row count is left to check against the table
+    RowBitmap deleted;
+    if (!m_vectorFile.openLabels(m_rowLabels, m_bits, deleted) || m_rowLabels.size() != m_matrix.rows()
+        || m_matrix.rows() - deleted.count() != expected) {
+        m_rowLabels.clear();
+        m_bits.clear();
+        return false;
+    }
+
+    // Postings per ordinal first, keyed by name once at the end
+    QVector<RowBitmap> docRows(m_rowLabels.names[RowLabels::Doc].size());
+    QVector<RowBitmap> typeRows(m_rowLabels.names[RowLabels::Type].size());
+    QVector<int> headingSlot(m_rowLabels.names[RowLabels::Heading].size());
+    for (int i = 0; i < headingSlot.size(); ++i) headingSlot[i] = m_headingSlots.value(m_rowLabels.names[RowLabels::Heading][i], -1);
+    m_rowHeading.reserve(m_matrix.rows());
+    for (int r = 0; r < m_matrix.rows(); ++r) {
+        if (deleted.test(r)) {
+            m_rowHeading.append(-1);
+            continue;
+        }
+        docRows[m_rowLabels.doc[r]].set(r);
+        typeRows[m_rowLabels.type[r]].set(r);
+        m_levelRows[m_rowLabels.level[r]].set(r);
+        m_rowHeading.append(headingSlot[m_rowLabels.heading[r]]);
+    }
+    for (int i = 0; i < docRows.size(); ++i) {
+        if (docRows[i].rows() > 0) m_docRows.insert(m_rowLabels.names[RowLabels::Doc][i], docRows[i]);
+    }
+    for (int i = 0; i < typeRows.size(); ++i) {
+        if (typeRows[i].rows() > 0) m_typeRows.insert(m_rowLabels.names[RowLabels::Type][i], typeRows[i]);
+    }
+    m_tombstones = deleted;
+    m_deadRows = deleted.count();
+    return true;
+}
+
+void VectorStore::loadStoredTiers() {
+    const int generation = m_indexGeneration.loadAcquire();
+    const ProductQuantizer pq = m_pq;
+    const PcaProjection pca = m_pca;
+    m_tierFuture = QtConcurrent::run(m_threadPool, [this, generation, pq, pca]() {
+        QElapsedTimer timer;
+        timer.start();
+        auto stale = [this, generation]() { return m_indexGeneration.loadAcquire() != generation; };
+
+        int dim = 0;
+        {
+            QReadLocker locker(&m_indexLock);
+            dim = m_matrix.dimension();
+        }
+        const int codeSize = pq.isTrained() && pq.dimension() == dim ? pq.codeSize() : 0;
+        const bool withReduced = pca.isTrained() && pca.inputDimension() == dim;
+        Sq8Matrix sq8;
+        VectorMatrix reduced;
+        QVector<uchar> pqCodes;
+        sq8.reset(dim);
+        if (withReduced) reduced.reset(pca.outputDimension());
+
+        // One row of every tier. Stored values win; a row the walk has no stored values for is
+        // either tombstoned (zero placeholder) or appended since the job started (encoded here)
+        struct Stored {
+            int id;
+            QByteArray sq8, pq, pca;
+        };
+        const QVector<int8_t> zeroCode(dim, 0);
+        QVector<int8_t> code(dim);
+        QVector<float> projected(withReduced ? pca.outputDimension() : 0);
+        int reencoded = 0, reprojected = 0;
+        auto fillRow = [&](int r, const Stored* s) {
+            const bool placeholder = !s && m_tombstones.test(r);
+            float scale = 0.0f;
+            if (placeholder) sq8.append(zeroCode.constData(), 0.0f);
+            else if (s && Sq8Matrix::fromBlob(s->sq8, dim, code.data(), scale)) sq8.append(code.constData(), scale);
+            else sq8.append(m_matrix.row(r));
+            if (withReduced) {
+                if (placeholder) {
+                    std::fill(projected.begin(), projected.end(), 0.0f);
+                } else if (!s || !VectorBlob::decode(s->pca, projected.data(), projected.size())) {
+                    pca.project(m_matrix.row(r), projected.data());
+                    if (s) reprojected++;
+                }
+                reduced.append(m_matrix.idAt(r), projected.constData());
+            }
+            if (codeSize) {
+                pqCodes.resize((r + 1) * codeSize); // Zero codes for placeholders
+                if (s && s->pq.size() == codeSize) {
+                    memcpy(pqCodes.data() + (size_t)r * codeSize, s->pq.constData(), codeSize);
+                } else if (!placeholder) {
+                    pq.encode(m_matrix.row(r), pqCodes.data() + (size_t)r * codeSize);
+                    if (s) reencoded++;
+                }
+            }
+        };
+
+        // 1. Stored tiers in id order, one chunk at a time; the index lock is only held while
+        //    a fetched chunk is matched to rows, never across a query
+        QSqlQuery q(connection());
+        q.setForwardOnly(true);
+        q.prepare("SELECT id, sq8_blob, pq_codes, pca_blob FROM embeddings WHERE id > :after ORDER BY id LIMIT 4096");
+        QVector<Stored> chunk;
+        int after = 0, done = 0;
+        do {
+            if (stale()) return;
+            q.bindValue(":after", after);
+            if (!q.exec()) {
+                qDebug() << "Stored tier load failed:" << q.lastError().text();
+                return;
+            }
+            chunk.clear();
+            while (q.next()) {
+                chunk.append({q.value(0).toInt(), q.value(1).toByteArray(), q.value(2).toByteArray(), q.value(3).toByteArray()});
+            }
+            if (!chunk.isEmpty()) after = chunk.last().id;
+
+            QReadLocker locker(&m_indexLock);
+            if (stale()) return;
+            for (const Stored& s : chunk) {
+                while (done < m_matrix.rows() && m_matrix.idAt(done) < s.id) fillRow(done++, nullptr);
+                if (done < m_matrix.rows() && m_matrix.idAt(done) == s.id) fillRow(done++, &s);
+            }
+        } while (chunk.size() == 4096);
+
+        // 2. Install, catching up on rows appended since the last chunk
+        QWriteLocker locker(&m_indexLock);
+        if (stale()) return;
+        for (; done < m_matrix.rows(); ++done) fillRow(done, nullptr);
+        std::swap(m_sq8, sq8);
+        if (withReduced) m_reduced.swap(reduced);
+        if (codeSize) m_pqCodes.swap(pqCodes);
+        qDebug() << "Stored tiers loaded for" << m_matrix.rows() << "rows in" << timer.elapsed() << "ms";
+
+        // The SQLite connection belongs to the owner thread
+        if (reencoded > 0 || reprojected > 0) {
+            qDebug() << "Encoded" << reencoded << "rows missing PQ codes," << reprojected << "missing PCA vectors";
+            QMetaObject::invokeMethod(this, [this, reencoded, reprojected]() {
+                QReadLocker locker(&m_indexLock);
+                if (reencoded > 0) persistPqCodes();
+                if (reprojected > 0) persistPcaRows();
+            }, Qt::QueuedConnection);
+        }
+    });
+}
+
+void VectorStore::selectScoreKernel(int dim) {
+    // Stored rows and queries are unit length, so cosine ranking is a plain dot product; the
+    // workspace has no other metric, which is why only Dot has fixed-width kernels
+    m_scoreKernel = SimdKernels::scoreKernel(dim, SimdKernels::Metric::Dot);
+    m_kernelDim = dim;
+    if (SimdKernels::hasFixedKernel(dim)) qDebug() << "Scan kernel fixed to" << dim << "dims";
+}
+
+void VectorStore::loadPcaProjection() {
+    m_pca = PcaProjection();
+    QString stored = getMetadata("pca_projection");
+    if (!stored.isEmpty() && m_pca.deserialize(QByteArray::fromBase64(stored.toLatin1()))) {
+        qDebug() << "PCA projection loaded:" << m_pca.inputDimension() << "->" << m_pca.outputDimension() << "dims";
+    }
+}
+
+void VectorStore::persistPcaRows() {
+    if (!m_pca.isTrained() || !m_db.isOpen()) return;
+    QElapsedTimer timer;
+    timer.start();
+
+    setMetadata("pca_projection", QString::fromLatin1(m_pca.serialize().toBase64()));
+
+    m_db.transaction();
+    QSqlQuery q(m_db);
+    q.prepare("UPDATE embeddings SET pca_blob = :blob WHERE id = :id");
+    for (int r = 0; r < m_reduced.rows(); ++r) {
+        q.bindValue(":blob", VectorBlob::encode(m_reduced.row(r), m_reduced.dimension(), m_blobType));
+        q.bindValue(":id", m_reduced.idAt(r));
+        q.exec();
+    }
+    m_db.commit();
+    qDebug() << "PCA vectors persisted for" << m_reduced.rows() << "rows in" << timer.elapsed() << "ms";
+}
+
+bool VectorStore::trainPcaProjection(int components, int iterations) {
+    if (m_trainFuture.isRunning() || m_tierFuture.isRunning() || m_matrix.isEmpty()) return false;
+
+    const int generation = m_indexGeneration.loadAcquire();
+    m_trainFuture = QtConcurrent::run(m_threadPool, [this, components, iterations, generation]() {
+        QElapsedTimer timer;
+        timer.start();
+        auto stale = [this, generation]() { return m_indexGeneration.loadAcquire() != generation; };
+
+        // 1. Evenly spaced sample; a few thousand rows pin down the top subspace
+        QVector<float> sample;
+        int dim = 0, sampleRows = 0;
+        {
+            QReadLocker locker(&m_indexLock);
+            const int rows = m_matrix.rows();
+            dim = m_matrix.dimension();
+            sampleRows = qMin(rows, qMax(4096, 16 * components));
+            sample.resize(sampleRows * dim);
+            for (int i = 0; i < sampleRows; ++i) {
+                const float* src = m_matrix.row((int)((qint64)i * rows / sampleRows));
+                std::copy(src, src + dim, sample.data() + (size_t)i * dim);
+            }
+        }
+
+        PcaProjection pca;
+        double energy = pca.train(sample.constData(), sampleRows, dim, components, iterations, m_benchSeed);
+        sample = QVector<float>();
+        if (!pca.isTrained() || stale()) return;
+
+        // 2. Project existing rows in short read-locked chunks
+        const int outDim = pca.outputDimension();
+        QVector<float> projected;
+        int done = 0;
+        for (;;) {
+            QReadLocker locker(&m_indexLock);
+            if (stale()) return;
+            const int end = qMin(m_matrix.rows(), done + 4096);
+            if (done == end) break;
+            projected.resize(end * outDim);
+            for (; done < end; ++done) pca.project(m_matrix.row(done), projected.data() + (size_t)done * outDim);
+        }
+
+        // 3. Install with catch-up; the SQLite connection belongs to the owner thread
+        QWriteLocker locker(&m_indexLock);
+        if (stale()) return;
+        projected.resize(m_matrix.rows() * outDim);
+        for (; done < m_matrix.rows(); ++done) pca.project(m_matrix.row(done), projected.data() + (size_t)done * outDim);
+        m_pca = pca;
+        m_reduced.reset(outDim);
+        m_reduced.reserve(m_matrix.rows());
+        for (int r = 0; r < m_matrix.rows(); ++r) m_reduced.append(m_matrix.idAt(r), projected.constData() + (size_t)r * outDim);
+        qDebug() << "PCA projection trained:" << dim << "->" << outDim << "dims," << QString::number(energy * 100.0, 'f', 1) + "% energy,"
+                 << sampleRows << "samples," << timer.elapsed() << "ms";
+
+        QMetaObject::invokeMethod(this, [this]() {
+            QReadLocker locker(&m_indexLock);
+            persistPcaRows();
+        }, Qt::QueuedConnection);
+    });
+    return true;
+}
+
+void VectorStore::loadPqCodec() {
+    m_pq = ProductQuantizer();
+    QSqlQuery q(m_db);
+    if (q.exec("SELECT codebook FROM pq_codebook WHERE id = 1") && q.next()) {
+        if (m_pq.deserialize(q.value(0).toByteArray())) {
+            qDebug() << "PQ codec loaded:" << m_pq.subspaces() << "subspaces x" << ProductQuantizer::kCentroids << "centroids";
+        }
+    }
+}
+
+void VectorStore::persistPqCodes() {
+    if (!m_pq.isTrained() || !m_db.isOpen()) return;
+    QElapsedTimer timer;
+    timer.start();
+
+    m_db.transaction();
+    QSqlQuery q(m_db);
+    q.prepare("INSERT OR REPLACE INTO pq_codebook (id, codebook) VALUES (1, :book)");
+    q.bindValue(":book", m_pq.serialize());
+    q.exec();
+
+    const int codeSize = m_pq.codeSize();
+    q.prepare("UPDATE embeddings SET pq_codes = :codes WHERE id = :id");
+    for (int r = 0; r < m_matrix.rows() && (r + 1) * codeSize <= m_pqCodes.size(); ++r) {
+        q.bindValue(":codes", QByteArray(reinterpret_cast<const char*>(m_pqCodes.constData() + (size_t)r * codeSize), codeSize));
+        q.bindValue(":id", m_matrix.idAt(r));
+        q.exec();
+    }
+    m_db.commit();
+    qDebug() << "PQ codes persisted for" << m_matrix.rows() << "rows in" << timer.elapsed() << "ms";
+}
+
+bool VectorStore::trainPqCodec(int subspaces, int iterations) {
+    if (m_trainFuture.isRunning() || m_tierFuture.isRunning() || m_matrix.isEmpty()) return false;
+
+    const int generation = m_indexGeneration.loadAcquire();
+    m_trainFuture = QtConcurrent::run(m_threadPool, [this, subspaces, iterations, generation]() {
+        QElapsedTimer timer;
+        timer.start();
+        auto stale = [this, generation]() { return m_indexGeneration.loadAcquire() != generation; };
+
+        // 1. Evenly spaced training sample (64 points per sub-centroid is plenty for 256-way k-means)
+        QVector<float> sample;
+        int dim = 0, sampleRows = 0;
+        {
+            QReadLocker locker(&m_indexLock);
+            const int rows = m_matrix.rows();
+            dim = m_matrix.dimension();
+            sampleRows = qMin(rows, 64 * ProductQuantizer::kCentroids);
+            sample.resize(sampleRows * dim);
+            for (int i = 0; i < sampleRows; ++i) {
+                const float* src = m_matrix.row((int)((qint64)i * rows / sampleRows));
+                std::copy(src, src + dim, sample.data() + (size_t)i * dim);
+            }
+        }
+
+        ProductQuantizer pq;
+        pq.train(sample.constData(), sampleRows, dim, subspaces, iterations, m_benchSeed);
+        sample = QVector<float>();
+        if (!pq.isTrained() || stale()) return;
+
+        // 2. Encode existing rows in short read-locked chunks
+        const int codeSize = pq.codeSize();
+        QVector<uchar> codes;
+        int encoded = 0;
+        for (;;) {
+            QReadLocker locker(&m_indexLock);
+            if (stale()) return;
+            const int end = qMin(m_matrix.rows(), encoded + 4096);
+            if (encoded == end) break;
+            codes.resize(end * codeSize);
+            for (; encoded < end; ++encoded) pq.encode(m_matrix.row(encoded), codes.data() + (size_t)encoded * codeSize);
+        }
+
+        // 3. Install with catch-up; the SQLite connection belongs to the owner thread
+        QWriteLocker locker(&m_indexLock);
+        if (stale()) return;
+        codes.resize(m_matrix.rows() * codeSize);
+        for (; encoded < m_matrix.rows(); ++encoded) pq.encode(m_matrix.row(encoded), codes.data() + (size_t)encoded * codeSize);
+        m_pq = pq;
+        m_pqCodes = codes;
+        qDebug() << "PQ codec trained:" << pq.subspaces() << "subspaces," << codeSize << "bytes per row,"
+                 << sampleRows << "samples," << timer.elapsed() << "ms";
+
+        QMetaObject::invokeMethod(this, [this]() {
+            QReadLocker locker(&m_indexLock);
+            persistPqCodes();
+        }, Qt::QueuedConnection);
+    });
+    return true;
+}
+
+bool VectorStore::compactIndex() {
+    if (m_trainFuture.isRunning() || m_tierFuture.isRunning() || m_deadRows == 0) return false;
+
+    const int generation = m_indexGeneration.loadAcquire();
+    m_trainFuture = QtConcurrent::run(m_threadPool, [this, generation]() {
+        QElapsedTimer timer;
+        timer.start();
+        auto stale = [this, generation]() { return m_indexGeneration.loadAcquire() != generation; };
+
+        // 1. Copy the live rows of every tier in short read-locked chunks; queries and
+        //    appends keep running against the current version meanwhile
+        VectorMatrix matrix, reduced;
+        Sq8Matrix sq8;
+        BinaryMatrix bits;
+        QVector<uchar> pqCodes;
+        QVector<int> rowHeading;
+        RowLabels labels; // Ordinals only until the names are taken over in step 3
+        QVector<int> remap; // Old row -> new row, -1 for dropped rows
+        int snapshotRows = 0, codeSize = 0;
+        bool withSq8 = false, withReduced = false;
+        {
+            QReadLocker locker(&m_indexLock);
+            snapshotRows = m_matrix.rows();
+            matrix.reset(m_matrix.dimension());
+            bits.reset(m_matrix.dimension());
+            withSq8 = m_sq8.rows() == snapshotRows;
+            if (withSq8) sq8.reset(m_matrix.dimension());
+            withReduced = m_reduced.dimension() > 0 && m_reduced.rows() == snapshotRows;
+            if (withReduced) reduced.reset(m_reduced.dimension());
+            if (m_pq.isTrained() && m_pqCodes.size() == snapshotRows * m_pq.codeSize()) codeSize = m_pq.codeSize();
+            if (m_annIndex && m_annIndex->size() != snapshotRows) return; // Resynced on the next open
+        }
+        auto copyRow = [&](int r) {
+            if (m_tombstones.test(r)) {
+                remap.append(-1);
+                return;
+            }
+            remap.append(matrix.append(m_matrix.idAt(r), m_matrix.row(r)));
+            bits.append(m_matrix.row(r));
+            rowHeading.append(m_rowHeading.value(r, -1));
+            labels.doc.append(m_rowLabels.doc.value(r, -1));
+            labels.type.append(m_rowLabels.type.value(r, -1));
+            labels.heading.append(m_rowLabels.heading.value(r, -1));
+            labels.level.append(m_rowLabels.level.value(r, 0));
+            if (withSq8) sq8.append(m_sq8.row(r), m_sq8.scale(r));
+            if (withReduced) reduced.append(m_reduced.idAt(r), m_reduced.row(r));
+            if (codeSize) {
+                const uchar* code = m_pqCodes.constData() + (size_t)r * codeSize;
+                pqCodes.append(QVector<uchar>(code, code + codeSize));
+            }
+        };
+        for (int r = 0; r < snapshotRows;) {
+            QReadLocker locker(&m_indexLock);
+            if (stale()) return;
+            for (const int end = qMin(snapshotRows, r + 4096); r < end; ++r) copyRow(r);
+        }
+
+        // 2. Carry the ANN structure over instead of rebuilding it: IVF keeps its centroids,
+        //    HNSW only repairs the neighbourhoods of dropped nodes
+        std::unique_ptr<IVectorIndex> index;
+        {
+            QReadLocker locker(&m_indexLock);
+            if (stale()) return;
+            if (m_annIndex) index = m_annIndex->compacted(matrix, remap);
+        }
+
+        // 3. Stage the new sidecar beside the live one. Names are append-only, so the current
+        //    tables cover every ordinal copied so far
+        {
+            QReadLocker locker(&m_indexLock);
+            for (int k = 0; k < RowLabels::KindCount; ++k) labels.names[k] = m_rowLabels.names[k];
+        }
+        VectorFile staged;
+        staged.setPaths(sidecarPath("vec"), sidecarPath("vid"));
+        const bool written = staged.stage(matrix, &labels, &bits);
+        const int stagedRows = matrix.rows();
+
+        // 4. Install, catching up on rows appended and deleted since the snapshot
+        QWriteLocker locker(&m_indexLock);
+        if (stale()) {
+            staged.discardStaged();
+            return;
+        }
+        const int oldRows = m_matrix.rows();
+        for (int r = snapshotRows; r < oldRows; ++r) copyRow(r);
+        if (index) {
+            for (int r = index->size(); r < matrix.rows(); ++r) index->add(matrix, r);
+        }
+        auto remapped = [&](const RowBitmap& old) {
+            RowBitmap out(matrix.rows());
+            old.forEach(0, old.rows(), [&](int r) {
+                if (remap[r] >= 0) out.set(remap[r]);
+            });
+            return out;
+        };
+        m_tombstones = remapped(m_tombstones);
+        m_deadRows = m_tombstones.count();
+        for (auto it = m_docRows.begin(); it != m_docRows.end(); ++it) it.value() = remapped(it.value());
+        for (auto it = m_typeRows.begin(); it != m_typeRows.end(); ++it) it.value() = remapped(it.value());
+        for (auto it = m_levelRows.begin(); it != m_levelRows.end(); ++it) it.value() = remapped(it.value());
+
+        // The ANN sidecar still describes the old layout: remove it before the new .vec lands
+        // so a crash in between costs a rebuild, never a mismatched index
+        if (m_annIndex) QFile::remove(sidecarPath(m_annIndex->name()));
+        m_matrix.swap(matrix);
+        matrix.clear(); // Drops the old rows, which may point into the mapping closed below
+        std::swap(m_bits, bits);
+        m_rowHeading.swap(rowHeading);
+        m_rowLabels.doc.swap(labels.doc); // Interned names are append-only, so they carry over
+        m_rowLabels.type.swap(labels.type);
+        m_rowLabels.heading.swap(labels.heading);
+        m_rowLabels.level.swap(labels.level);
+        if (written && m_vectorFile.commitStaged() && m_vectorFile.open(m_matrix.dimension())
+            && m_vectorFile.rows() == stagedRows) {
+            m_matrix.shareRows(m_vectorFile.data(), stagedRows);
+            for (int r = stagedRows; r < m_matrix.rows(); ++r) {
+                if (m_vectorFile.append(m_matrix, r)) m_vectorFile.appendLabels(m_rowLabels, m_bits, r);
+            }
+            m_tombstones.forEach(0, m_tombstones.rows(), [&](int r) { m_vectorFile.appendDeleted(r); });
+        } else {
+            m_vectorFile.remove(); // Rebuilt from the blobs on the next open
+        }
+        if (withSq8) std::swap(m_sq8, sq8);
+        else m_sq8.clear();
+        if (withReduced) m_reduced.swap(reduced);
+        else m_reduced.clear();
+        if (codeSize) m_pqCodes.swap(pqCodes);
+        else m_pqCodes.clear();
+        if (index) installAnnIndex(std::move(index));
+
+        qDebug() << "Index compacted:" << oldRows << "->" << m_matrix.rows() << "rows in" << timer.elapsed() << "ms";
+    });
     return true;
 }
 
@@ -159,13 +1380,44 @@ bool VectorStore::addEntry(const QString& text, const QVector<float>& embedding,
         qDebug() << "Cannot add entry: Database is not open!";
         return false;
     }
+    // Store unit-length vectors so every later similarity is a plain dot product
+    QVector<float> unitVec = embedding;
+    float norm = SimdKernels::normalize(unitVec.data(), unitVec.size());
+
+    // Held until the row is resident so the codec can't change between encode and append
+    QWriteLocker indexLocker(&m_indexLock);
+    QByteArray pqCode;
+    if (m_pq.isTrained() && unitVec.size() == m_pq.dimension()) {
+        pqCode.resize(m_pq.codeSize());
+        m_pq.encode(unitVec.constData(), reinterpret_cast<uchar*>(pqCode.data()));
+    }
+
+    QVector<int8_t> sq8Code(unitVec.size());
+    float sq8Scale = Sq8Matrix::quantize(unitVec.constData(), unitVec.size(), sq8Code.data());
+
+    QVector<float> reduced;
+    if (m_pca.isTrained() && unitVec.size() == m_pca.inputDimension()) {
+        reduced.resize(m_pca.outputDimension());
+        m_pca.project(unitVec.constData(), reduced.data());
+    }
+
+    // Sections embedded earlier share their heading vector with every new chunk
+    const int headingSlot = m_headingSlots.value(path, -1);
+    QByteArray headingBlob;
+    if (headingSlot >= 0) headingBlob = VectorBlob::encode(m_headingVecs.row(headingSlot), m_headingVecs.dimension(), m_blobType);
+
     QSqlQuery query(m_db);
-    query.prepare("INSERT INTO embeddings (source_file, text_chunk, vector_blob, doc_id, page_num, chunk_idx, model_sig, model_dim, heading_path, heading_level, chunk_type, sentence_count, list_type, list_length) "
-                  "VALUES (:source, :text, :blob, :docid, :page, :index, :sig, :dim, :path, :level, :type, :scount, :ltype, :llen)");
+    query.prepare("INSERT INTO embeddings (source_file, text_chunk, vector_blob, vector_norm, pq_codes, sq8_blob, pca_blob, heading_vec_blob, doc_id, page_num, chunk_idx, model_sig, model_dim, heading_path, heading_level, chunk_type, sentence_count, list_type, list_length) "
+                  "VALUES (:source, :text, :blob, :norm, :pq, :sq8, :pca, :hvec, :docid, :page, :index, :sig, :dim, :path, :level, :type, :scount, :ltype, :llen)");
     
     query.bindValue(":source", sourceFile);
     query.bindValue(":text", text);
-    query.bindValue(":blob", vectorToBlob(embedding));
+    query.bindValue(":blob", vectorToBlob(unitVec));
+    query.bindValue(":norm", norm);
+    query.bindValue(":pq", pqCode.isEmpty() ? QVariant() : QVariant(pqCode));
+    query.bindValue(":sq8", Sq8Matrix::toBlob(sq8Code.constData(), sq8Code.size(), sq8Scale));
+    query.bindValue(":pca", reduced.isEmpty() ? QVariant() : QVariant(VectorBlob::encode(reduced.constData(), reduced.size(), m_blobType)));
+    query.bindValue(":hvec", headingBlob.isEmpty() ? QVariant() : QVariant(headingBlob));
     query.bindValue(":docid", docId);
     query.bindValue(":page", pageNum);
     query.bindValue(":index", chunkIdx);
@@ -186,54 +1438,514 @@ bool VectorStore::addEntry(const QString& text, const QVector<float>& embedding,
     // Update Registered Dimension if this is the first entry
     if (getRegisteredDimension() == 0) {
         setRegisteredDimension(embedding.size());
+        selectScoreKernel(embedding.size());
     }
 
     qlonglong lastId = query.lastInsertId().toLongLong();
+    if (m_matrix.dimension() == 0 && !embedding.isEmpty()) {
+        m_matrix.reset(embedding.size());
+        m_sq8.reset(embedding.size());
+        m_bits.reset(embedding.size());
+    }
+    if (unitVec.size() == m_matrix.dimension()) {
+        int row = m_matrix.append((int)lastId, unitVec.constData());
+        if (row == m_sq8.rows()) m_sq8.append(sq8Code.constData(), sq8Scale);
+        if (row == m_bits.rows()) m_bits.append(unitVec.constData());
+        m_docRows[docId].set(row);
+        m_typeRows[chunkType].set(row);
+        m_levelRows[level].set(row);
+        if (row == m_rowLabels.size()) m_rowLabels.append(docId, chunkType, path, level);
+        if (row == m_rowHeading.size()) m_rowHeading.append(headingSlot);
+        // A missed row (or label) just makes the next open rebuild it
+        if (m_vectorFile.append(m_matrix, row)) m_vectorFile.appendLabels(m_rowLabels, m_bits, row);
+        if (!reduced.isEmpty() && m_reduced.dimension() == 0) m_reduced.reset(reduced.size());
+        if (!reduced.isEmpty() && row == m_reduced.rows()) m_reduced.append((int)lastId, reduced.constData());
+        if (!pqCode.isEmpty() && m_pqCodes.size() == row * pqCode.size()) {
+            const uchar* code = reinterpret_cast<const uchar*>(pqCode.constData());
+            m_pqCodes.append(QVector<uchar>(code, code + pqCode.size()));
+        }
+        if (m_annIndex && row == m_annIndex->size()) {
+            m_annIndex->add(m_matrix, row);
+            m_annDirty = true;
+        }
+    }
+    if (m_keywordIndexEnabled) m_keywordIndex.add((int)lastId, path, text);
+    indexLocker.unlock();
+
     QSqlQuery ftsQuery(m_db);
-    ftsQuery.prepare("INSERT INTO embeddings_fts(rowid, text_chunk) VALUES (:id, :text)");
-    
-    QString headingTokens = path;
-    headingTokens.replace(QRegularExpression("[^a-zA-Z0-9\\s]"), " ");
-    QString indexedText = QString("[CONTEXT: %1] %2").arg(headingTokens).arg(text);
-    
+    ftsQuery.prepare("INSERT INTO embeddings_fts(rowid, heading_path, text_chunk) VALUES (:id, :path, :text)");
     ftsQuery.bindValue(":id", lastId);
-    ftsQuery.bindValue(":text", indexedText);
+    ftsQuery.bindValue(":path", path);
+    ftsQuery.bindValue(":text", text);
     ftsQuery.exec();
+    if (isCodeChunk(chunkType)) {
+        ftsQuery.prepare("INSERT INTO embeddings_code_fts(rowid, text_chunk) VALUES (:id, :text)");
+        ftsQuery.bindValue(":id", lastId);
+        ftsQuery.bindValue(":text", text);
+        ftsQuery.exec();
+    }
     
     return true;
 }
 
-QVector<VectorEntry> VectorStore::search(const QVector<float>& queryEmbedding, int limit) {
-    QVector<VectorEntry> semanticResults;
-    QSqlQuery query("SELECT id, text_chunk, vector_blob, source_file, doc_id, page_num, model_sig, created_at, boost_factor FROM embeddings", m_db);
+void VectorStore::loadHeadingVectors() {
+    m_headingVecs.clear();
+    m_headingSlots.clear();
+
+    // Stored per row for simple joins, but identical within a section: decode one per path
+    QSqlQuery q(m_db);
+    q.setForwardOnly(true);
+    if (!q.exec("SELECT heading_path, MIN(heading_vec_blob) FROM embeddings WHERE heading_vec_blob IS NOT NULL GROUP BY heading_path")) return;
+    QVector<float> vec;
+    while (q.next()) {
+        QByteArray blob = q.value(1).toByteArray();
+        int dim = VectorBlob::dimension(blob);
+        if (dim <= 0 || (m_headingVecs.dimension() > 0 && dim != m_headingVecs.dimension())) continue;
+        vec.resize(dim);
+        if (!VectorBlob::decode(blob, vec.data(), dim)) continue;
+        if (m_headingVecs.dimension() == 0) m_headingVecs.reset(dim);
+        const int slot = m_headingVecs.rows();
+        m_headingVecs.append(slot, vec.constData());
+        m_headingSlots.insert(q.value(0).toString(), slot);
+    }
+    if (!m_headingSlots.isEmpty()) qDebug() << "Heading vectors loaded:" << m_headingSlots.size() << "sections";
+}
+
+bool VectorStore::hasHeadingVector(const QString& headingPath) const {
+    QReadLocker locker(&m_indexLock);
+    return m_headingSlots.contains(headingPath);
+}
+
+bool VectorStore::setHeadingVector(const QString& headingPath, const QVector<float>& embedding) {
+    if (!m_db.isOpen() || headingPath.isEmpty() || embedding.isEmpty()) return false;
+    QVector<float> unitVec = embedding;
+    SimdKernels::normalize(unitVec.data(), unitVec.size());
+
+    QWriteLocker locker(&m_indexLock);
+    if (m_headingVecs.dimension() == 0) m_headingVecs.reset(unitVec.size());
+    if (unitVec.size() != m_headingVecs.dimension()) return false;
+
+    if (m_headingSlots.contains(headingPath)) return true; // Computed once per section
+    const int slot = m_headingVecs.rows();
+    m_headingVecs.append(slot, unitVec.constData());
+    m_headingSlots.insert(headingPath, slot);
+
+    // Chunks of the section that are already stored pick the vector up as well
+    QSqlQuery q(m_db);
+    q.prepare("UPDATE embeddings SET heading_vec_blob = :blob WHERE heading_path = :path");
+    q.bindValue(":blob", VectorBlob::encode(unitVec.constData(), unitVec.size(), m_blobType));
+    q.bindValue(":path", headingPath);
+    if (!q.exec()) qDebug() << "Heading vector update failed:" << q.lastError().text();
+    q.prepare("SELECT id FROM embeddings WHERE heading_path = :path");
+    q.bindValue(":path", headingPath);
+    if (q.exec()) {
+        while (q.next()) {
+            int row = rowOf(q.value(0).toInt());
+            if (row >= 0 && row < m_rowHeading.size()) m_rowHeading[row] = slot;
+        }
+    }
+    return true;
+}
+
+int VectorStore::deleteDocument(const QString& docId) {
+    QVector<int> ids;
+    QSqlQuery q(m_db);
+    q.prepare("SELECT id FROM embeddings WHERE doc_id = :doc");
+    q.bindValue(":doc", docId);
+    if (q.exec()) {
+        while (q.next()) ids.append(q.value(0).toInt());
+    }
+    return deleteEntries(ids);
+}
+
+int VectorStore::deleteEntries(const QVector<int>& ids) {
+    if (!m_db.isOpen() || ids.isEmpty()) return 0;
+    QStringList idList;
+    idList.reserve(ids.size());
+    for (int id : ids) idList.append(QString::number(id));
+    const QString inList = idList.join(",");
+
+    // The FTS table is external-content: its 'delete' command needs the values that were indexed
+    QVector<int> removed;
+    QStringList removedPaths, removedTexts; // For the resident keyword index statistics
+    m_db.transaction();
+    QSqlQuery select(m_db);
+    select.setForwardOnly(true);
+    QSqlQuery fts(m_db);
+    fts.prepare("INSERT INTO embeddings_fts(embeddings_fts, rowid, heading_path, text_chunk) VALUES ('delete', :id, :path, :text)");
+    QSqlQuery codeFts(m_db);
+    codeFts.prepare("INSERT INTO embeddings_code_fts(embeddings_code_fts, rowid, text_chunk) VALUES ('delete', :id, :text)");
+    if (select.exec("SELECT id, heading_path, text_chunk, chunk_type FROM embeddings WHERE id IN (" + inList + ")")) {
+        while (select.next()) {
+            fts.bindValue(":id", select.value(0).toInt());
+            fts.bindValue(":path", select.value(1));
+            fts.bindValue(":text", select.value(2));
+            fts.exec();
+            if (isCodeChunk(select.value(3).toString())) {
+                codeFts.bindValue(":id", select.value(0).toInt());
+                codeFts.bindValue(":text", select.value(2));
+                codeFts.exec();
+            }
+            removed.append(select.value(0).toInt());
+            removedPaths.append(select.value(1).toString());
+            removedTexts.append(select.value(2).toString());
+        }
+    }
+    QSqlQuery del(m_db);
+    if (!del.exec("DELETE FROM embeddings WHERE id IN (" + inList + ")")) {
+        qDebug() << "Delete failed:" << del.lastError().text();
+        m_db.rollback();
+        return 0;
+    }
+    m_db.commit();
+
+    // Resident tiers only flag the rows; searches skip them until compaction drops them
+    bool compact = false;
+    {
+        QWriteLocker locker(&m_indexLock);
+        for (int i = 0; i < removed.size(); ++i) {
+            if (m_keywordIndexEnabled) m_keywordIndex.remove(removed[i], removedPaths[i], removedTexts[i]);
+            const int id = removed[i];
+            int row = rowOf(id);
+            if (row < 0 || m_tombstones.test(row)) continue;
+            m_tombstones.set(row);
+            m_deadRows++;
+            m_vectorFile.appendDeleted(row);
+        }
+        compact = m_deadRows > kCompactDeadFraction * m_matrix.rows();
+    }
+    {
+        QMutexLocker locker(&m_cacheMutex);
+        m_queryCache.clear();
+        m_semanticCache.clear();
+    }
+    if (compact) compactIndex(); // No-op while another background job holds the slot
+    return removed.size();
+}
+
+QVector<VectorEntry> VectorStore::search(const QVector<float>& queryEmbedding, int limit, const SearchOptions& options) {
+    QReadLocker indexLocker(&m_indexLock);
+    // Scoring only sees row ordinals; text and metadata are fetched for the survivors
+    return hydrateHits(rankRows(queryEmbedding, limit, options));
+}
+
+QVector<ScoredRow> VectorStore::rankRows(const QVector<float>& queryEmbedding, int limit, const SearchOptions& options) {
+    if (queryEmbedding.size() != m_matrix.dimension() || m_matrix.isEmpty()) return {};
+
+    // Stored rows are unit length; normalizing the query once makes cosine a dot product
+    const int dim = m_matrix.dimension();
+    const int rows = m_matrix.rows();
+    QVector<float> query = queryEmbedding;
+    SimdKernels::normalize(query.data(), dim);
+
+    // Fixed-width kernel when the matrix has the width it was resolved for
+    const SimdKernels::ScoreFn dotRow = m_kernelDim == dim ? m_scoreKernel : SimdKernels::dot;
+
+    // Heading-path field: one dot product per distinct section, not per row, then each
+    // row's chunk score is blended with its section's score (rows without one keep theirs)
+    const float headingWeight = m_headingVecs.dimension() == dim && m_rowHeading.size() == rows
+        ? qBound(0.0f, options.headingWeight, 1.0f) : 0.0f;
+    QVector<float> headingSims;
+    if (headingWeight > 0.0f) {
+        headingSims.resize(m_headingVecs.rows());
+        for (int s = 0; s < headingSims.size(); ++s) headingSims[s] = SimdKernels::dot(query.constData(), m_headingVecs.row(s), dim);
+    }
+    auto fuse = [&](int r, float chunkSim) {
+        const int slot = headingWeight > 0.0f ? m_rowHeading[r] : -1;
+        return slot < 0 ? chunkSim : (1.0f - headingWeight) * chunkSim + headingWeight * headingSims[slot];
+    };
+
+    // Exact full-dim re-score of a first-stage shortlist
+    auto rescore = [&](TopK& shortlist) {
+        TopK topK(limit);
+        for (const ScoredRow& c : shortlist.takeSorted()) {
+            topK.push(c.row, fuse(c.row, dotRow(query.constData(), m_matrix.row(c.row), dim)));
+        }
+        return topK.takeSorted();
+    };
+
+    // Metadata filter (and deleted rows): compiled once into an allow-list every tier below honours
+    RowBitmap filterRows;
+    const RowBitmap* allowed = compileFilter(options.filter, filterRows) ? &filterRows : nullptr;
+    const int matches = allowed ? filterRows.count() : rows;
+    if (matches == 0) return {};
+    const bool approximate = matches > kFilteredExactRows || !allowed;
+
+    QVector<ScoredRow> scored;
+    if (approximate && options.binaryPrefilter && m_bits.rows() == rows) {
+        // Broad-recall first stage: XOR + popcount over 1-bit sketches, then float re-score
+        const int words = m_bits.words();
+        QVector<uint64_t> sketch(words);
+        BinaryMatrix::encode(query.constData(), dim, sketch.data());
+        TopK shortlist = shardedScan(m_threadPool, rows, options.binaryShortlist > 0 ? qMax(options.binaryShortlist, limit) : 20 * limit,
+                                     words * sizeof(uint64_t), allowed, [&](int r) {
+            return -(float)SimdKernels::hamming(sketch.constData(), m_bits.row(r), words);
+        });
+        scored = rescore(shortlist);
+    } else if (approximate && m_annIndex && m_annIndex->size() == rows) {
+        // Approximate path: graph walk / probed lists touch a small fraction of rows
+        // The graph only knows chunk vectors, so a fused query over-fetches and re-ranks
+        IndexQuery params;
+        params.k = headingWeight > 0.0f ? 4 * limit : limit;
+        params.efSearch = options.efSearch;
+        params.nprobe = options.nprobe;
+        params.filter = allowed;
+        scored = m_annIndex->search(m_matrix, query.constData(), params);
+        if (headingWeight > 0.0f) {
+            TopK topK(limit);
+            for (const ScoredRow& hit : scored) topK.push(hit.row, fuse(hit.row, hit.score));
+            scored = topK.takeSorted();
+        }
+    } else if (approximate && m_pq.isTrained() && m_pqCodes.size() == rows * m_pq.codeSize()) {
+        // Compressed scan: ADC over M-byte codes, then exact re-score of the best candidates
+        const int codeSize = m_pq.codeSize();
+        QVector<float> table(codeSize * ProductQuantizer::kCentroids);
+        m_pq.computeTable(query.constData(), table.data());
+        TopK shortlist = shardedScan(m_threadPool, rows, options.pqRescore > 0 ? qMax(options.pqRescore, limit) : 4 * limit,
+                                     codeSize, allowed, [&](int r) {
+            return ProductQuantizer::score(table.constData(), m_pqCodes.constData() + (size_t)r * codeSize, codeSize);
+        });
+        scored = rescore(shortlist);
+    } else if (approximate && m_pca.isTrained() && m_reduced.rows() == rows) {
+        // Cascade: rank everything in the projected space, re-score the shortlist at full dim
+        const int reducedDim = m_reduced.dimension();
+        QVector<float> reducedQuery(reducedDim);
+        m_pca.project(query.constData(), reducedQuery.data());
+        TopK shortlist = shardedScan(m_threadPool, rows, options.pcaShortlist > 0 ? qMax(options.pcaShortlist, limit) : 10 * limit,
+                                     m_reduced.stride() * sizeof(float), allowed, [&](int r) {
+            return SimdKernels::dot(reducedQuery.constData(), m_reduced.row(r), reducedDim);
+        });
+        scored = rescore(shortlist);
+    } else if (approximate && options.sq8Oversample > 0 && matches > kSq8MinRows && m_sq8.rows() == rows) {
+        // Int8 scan (a quarter of the float bytes), then exact re-score of limit x oversample rows.
+        // The query's own scale is constant across rows, so only the row scale affects ranking.
+        QVector<int8_t> qCode(dim);
+        Sq8Matrix::quantize(query.constData(), dim, qCode.data());
+        TopK shortlist = shardedScan(m_threadPool, rows, limit * options.sq8Oversample, m_sq8.stride(), allowed, [&](int r) {
+            return m_sq8.scale(r) * (float)SimdKernels::dotInt8(qCode.constData(), m_sq8.row(r), dim);
+        });
+        scored = rescore(shortlist);
+    } else {
+        // In-RAM scan over the resident matrix: only (row, score) pairs are kept, bounded to limit
+        scored = shardedScan(m_threadPool, rows, limit, m_matrix.stride() * sizeof(float), allowed, [&](int r) {
+            return fuse(r, dotRow(query.constData(), m_matrix.row(r), dim));
+        }).takeSorted();
+    }
+
+    return scored;
+}
+
+QVector<VectorEntry> VectorStore::hydrateHits(const QVector<ScoredRow>& hits) {
+    QVector<VectorEntry> results(hits.size());
+    for (int i = 0; i < hits.size(); ++i) {
+        results[i].id = m_matrix.idAt(hits[i].row);
+        results[i].score = hits[i].score;
+    }
+    hydrateEntries(results);
+    return results;
+}
+
+void VectorStore::hydrateEntries(QVector<VectorEntry>& entries) {
+    if (entries.isEmpty()) return;
+
+    // One statement for the whole batch. The ids come from the index, not the user, so
+    // inlining them is safe and avoids SQLite's cap on bound parameters.
+    QStringList idList;
+    QHash<int, int> slot;
+    for (int i = 0; i < entries.size(); ++i) {
+        idList << QString::number(entries[i].id);
+        slot.insert(entries[i].id, i);
+    }
+    QSqlQuery hydrate(connection());
+    hydrate.setForwardOnly(true);
+    if (!hydrate.exec("SELECT id, text_chunk, source_file, doc_id, page_num, model_sig, created_at, boost_factor, heading_path, heading_level, "
+                      "chunk_type, sentence_count, list_type, list_length FROM embeddings WHERE id IN (" + idList.join(",") + ")")) {
+        qDebug() << "Hydration failed:" << hydrate.lastError().text();
+        entries.clear();
+        return;
+    }
+
+    QVector<bool> found(entries.size(), false);
+    while (hydrate.next()) {
+        int i = slot.value(hydrate.value(0).toInt(), -1);
+        if (i < 0) continue;
+        VectorEntry& entry = entries[i];
+        found[i] = true;
+        entry.text = hydrate.value(1).toString();
+        entry.sourceFile = hydrate.value(2).toString();
+        entry.docId = hydrate.value(3).toString();
+        entry.pageNum = hydrate.value(4).toInt();
+        entry.modelSig = hydrate.value(5).toString();
+        entry.createdAt = hydrate.value(6).toDateTime();
+        entry.headingPath = hydrate.value(8).toString();
+        entry.headingLevel = hydrate.value(9).toInt();
+        entry.chunkType = hydrate.value(10).toString();
+        entry.sentenceCount = hydrate.value(11).toInt();
+        entry.listType = hydrate.value(12).toString();
+        entry.listLength = hydrate.value(13).toInt();
 
-    while (query.next()) {
-        VectorEntry entry;
-        entry.id = query.value(0).toInt();
-        entry.text = query.value(1).toString();
-        entry.embedding = blobToVector(query.value(2).toByteArray());
-        entry.sourceFile = query.value(3).toString();
-        entry.docId = query.value(4).toString();
-        entry.pageNum = query.value(5).toInt();
-        entry.modelSig = query.value(6).toString();
-        entry.createdAt = query.value(7).toDateTime();
-        
         // Phase 4.2: Trust Multiplier based on recency & boost
-        float boost = query.value(8).toFloat();
+        float boost = hydrate.value(7).toFloat();
         qint64 secsAgo = entry.createdAt.secsTo(QDateTime::currentDateTime());
         float recencyFactor = qMax(0.5f, 1.0f - (float)secsAgo / (3600.0f * 24.0f * 30.0f)); // Decay over 30 days
         entry.trustScore = boost * recencyFactor;
-        
-        entry.score = cosineSimilarity(queryEmbedding, entry.embedding);
-        semanticResults.append(entry);
+
+        int row = rowOf(entry.id);
+        if (row >= 0) entry.embedding = QVector<float>(m_matrix.row(row), m_matrix.row(row) + m_matrix.dimension());
     }
 
-    std::sort(semanticResults.begin(), semanticResults.end(), [](const VectorEntry& a, const VectorEntry& b) {
-        return a.score > b.score;
+    // Rows deleted since scoring drop out; the rest keep their ranked order
+    int kept = 0;
+    for (int i = 0; i < entries.size(); ++i) {
+        if (found[i]) entries[kept++] = entries[i];
+    }
+    entries.resize(kept);
+}
+
+QVector<ScoredRow> VectorStore::residentKeywordHits(const QString& queryText, int limit, const SearchFilter& filter) {
+    if (filter.isEmpty()) return m_keywordIndex.search(queryText, limit);
+
+    // The index is keyed by id: carry the compiled row filter over to an id bitmap
+    RowBitmap allowedRows;
+    if (!compileFilter(filter, allowedRows)) return m_keywordIndex.search(queryText, limit);
+    RowBitmap allowedIds;
+    allowedRows.forEach(0, allowedRows.rows(), [&](int r) { allowedIds.set(m_matrix.idAt(r)); });
+    return m_keywordIndex.search(queryText, limit, &allowedIds);
+}
+
+void VectorStore::loadKeywordIndex() {
+    m_keywordIndex.clear();
+    if (!m_keywordIndexEnabled) return;
+    QElapsedTimer timer;
+    timer.start();
+    QSqlQuery q(m_db);
+    q.setForwardOnly(true);
+    if (q.exec("SELECT id, heading_path, text_chunk FROM embeddings ORDER BY id")) {
+        while (q.next()) m_keywordIndex.add(q.value(0).toInt(), q.value(1).toString(), q.value(2).toString());
+    }
+    qDebug() << "Keyword index loaded:" << m_keywordIndex.documentCount() << "rows," << m_keywordIndex.termCount()
+             << "terms," << m_keywordIndex.memoryBytes() / (1024 * 1024) << "MB in" << timer.elapsed() << "ms";
+}
+
+bool VectorStore::setKeywordIndexEnabled(bool enabled) {
+    if (!m_db.isOpen()) return false;
+    setMetadata("keyword_index", enabled ? "memory" : "fts");
+    QWriteLocker locker(&m_indexLock);
+    m_keywordIndexEnabled = enabled;
+    loadKeywordIndex();
+    return true;
+}
+
+int VectorStore::rowOf(int id) const {
+    const QVector<int>& ids = m_matrix.ids();
+    auto it = std::lower_bound(ids.constBegin(), ids.constEnd(), id);
+    return it != ids.constEnd() && *it == id ? (int)(it - ids.constBegin()) : -1;
+}
+
+bool VectorStore::compileFilter(const SearchFilter& filter, RowBitmap& allowed) {
+    const int rows = m_matrix.rows();
+    if (filter.isEmpty()) {
+        if (m_deadRows == 0) return false;
+        allowed = RowBitmap(rows, true); // Deleted rows are the only restriction
+        allowed.subtract(m_tombstones);
+        return true;
+    }
+
+    // doc_id / chunk_type: OR the posting bitmaps of each listed value
+    auto unionOf = [&](const QHash<QString, RowBitmap>& postings, const QStringList& values) {
+        RowBitmap any(rows);
+        for (const QString& v : values) {
+            auto it = postings.constFind(v);
+            if (it != postings.constEnd()) any.unite(*it);
+        }
+        return any;
+    };
+    allowed = filter.docIds.isEmpty() ? RowBitmap(rows, true) : unionOf(m_docRows, filter.docIds);
+    if (!filter.chunkTypes.isEmpty()) allowed.intersect(unionOf(m_typeRows, filter.chunkTypes));
+
+    // Heading subtree / page range have no resident copy: one id query, mapped to rows
+    QVariantList binds;
+    QString clause = filterClause(filter, false, binds);
+    if (!clause.isEmpty()) {
+        QSqlQuery q(connection());
+        q.setForwardOnly(true);
+        q.prepare("SELECT id FROM embeddings WHERE 1 = 1" + clause + " ORDER BY id");
+        for (const QVariant& v : binds) q.addBindValue(v);
+        RowBitmap matching(rows);
+        if (!q.exec()) {
+            qDebug() << "Filter query failed:" << q.lastError().text();
+        } else {
+            // Both sides ascend by id, so the lookup cursor only moves forward
+            const QVector<int>& ids = m_matrix.ids();
+            auto cursor = ids.constBegin();
+            while (q.next()) {
+                cursor = std::lower_bound(cursor, ids.constEnd(), q.value(0).toInt());
+                if (cursor == ids.constEnd()) break;
+                if (*cursor == q.value(0).toInt()) matching.set(cursor - ids.constBegin());
+            }
+        }
+        allowed.intersect(matching);
+    }
+    allowed.subtract(m_tombstones);
+    return true;
+}
+
+QVector<QVector<VectorEntry>> VectorStore::searchBatch(const QVector<QVector<float>>& queries, int k) {
+    QVector<QVector<VectorEntry>> results(queries.size());
+    QReadLocker indexLocker(&m_indexLock);
+    const int dim = m_matrix.dimension();
+    const int rows = m_matrix.rows();
+    if (m_matrix.isEmpty() || queries.isEmpty() || k <= 0) return results;
+
+    QElapsedTimer timer;
+    timer.start();
+
+    // Normalized, padded copies of the usable queries (wrong dimension -> empty result)
+    QVector<int> queryIndex;
+    for (int i = 0; i < queries.size(); ++i) {
+        if (queries[i].size() == dim) queryIndex.append(i);
+    }
+    const int nq = queryIndex.size();
+    if (nq == 0) return results;
+    const int groups = (nq + 3) / 4;
+    QVector<float> packed(groups * 4 * dim, 0.0f); // Last group padded with zero queries
+    for (int j = 0; j < nq; ++j) {
+        float* q = packed.data() + (size_t)j * dim;
+        std::copy(queries[queryIndex[j]].constBegin(), queries[queryIndex[j]].constEnd(), q);
+        SimdKernels::normalize(q, dim);
+    }
+
+    // Query tiles run in parallel; inside a tile each corpus block (~L2-sized) is streamed
+    // once and reused by every 4-query group, so corpus traffic drops by the tile width
+    const int rowBytes = m_matrix.stride() * sizeof(float);
+    const int blockRows = qMax(16, kBatchBlockBytes / qMax(1, rowBytes));
+    const int groupsPerTile = qBound(1, (groups + m_threadPool->maxThreadCount() - 1) / m_threadPool->maxThreadCount(), kBatchTileGroups);
+    QVector<TopK> best(groups * 4, TopK(k));
+    TopK* bestData = best.data();
+    QVector<int> tiles;
+    for (int g = 0; g < groups; g += groupsPerTile) tiles.append(g);
+
+    QtConcurrent::blockingMap(m_threadPool, tiles, [&](int firstGroup) {
+        const int lastGroup = qMin(groups, firstGroup + groupsPerTile);
+        float scores[4];
+        for (int block = 0; block < rows; block += blockRows) {
+            const int blockEnd = qMin(rows, block + blockRows);
+            for (int g = firstGroup; g < lastGroup; ++g) {
+                const float* q = packed.constData() + (size_t)g * 4 * dim;
+                const float* group[4] = {q, q + dim, q + 2 * dim, q + 3 * dim};
+                TopK* topK = bestData + g * 4;
+                for (int r = block; r < blockEnd; ++r) {
+                    if (m_deadRows > 0 && m_tombstones.test(r)) continue;
+                    SimdKernels::dot4(m_matrix.row(r), group, dim, scores);
+                    for (int j = 0; j < 4; ++j) topK[j].push(r, scores[j]);
+                }
+            }
+        }
     });
 
-    if (semanticResults.size() > limit) semanticResults.resize(limit);
-    return semanticResults;
+    for (int j = 0; j < nq; ++j) results[queryIndex[j]] = hydrateHits(best[j].takeSorted());
+    qDebug() << "Batch search:" << nq << "queries x" << rows << "rows in" << timer.elapsed() << "ms";
+    return results;
 }
 
 IntentType VectorStore::detectIntent(const QString& queryText, const QVector<float>& queryEmbedding) {
@@ -247,30 +1959,24 @@ IntentType VectorStore::detectIntent(const QString& queryText, const QVector<flo
 
 QVector<VectorEntry> VectorStore::ftsSearch(const QString& queryText, int limit) {
     QVector<VectorEntry> results;
-    QSqlQuery q(m_db);
-    q.prepare("SELECT id, text_chunk, source_file, page_num, heading_path, heading_level, chunk_type, doc_id, sentence_count, list_type, list_length, created_at, boost_factor FROM embeddings "
-              "WHERE id IN (SELECT rowid FROM embeddings_fts WHERE embeddings_fts MATCH :query) LIMIT :limit");
-    q.bindValue(":query", queryText);
-    q.bindValue(":limit", limit);
-    
-    if (q.exec()) {
-        while(q.next()) {
-            VectorEntry e;
-            e.id = q.value(0).toInt();
-            e.text = q.value(1).toString();
-            e.sourceFile = q.value(2).toString();
-            e.pageNum = q.value(3).toInt();
-            e.headingPath = q.value(4).toString();
-            e.headingLevel = q.value(5).toInt();
-            e.chunkType = q.value(6).toString();
-            e.docId = q.value(7).toString();
-            e.sentenceCount = q.value(8).toInt();
-            e.listType = q.value(9).toString();
-            e.listLength = q.value(10).toInt();
-            e.score = 0.5; // Baseline score for FTS-only
-            results.append(e);
-        }
+    QReadLocker indexLocker(&m_indexLock);
+    QVector<KeywordHit> hits;
+    if (m_keywordIndexEnabled) {
+        for (const ScoredRow& hit : residentKeywordHits(queryText, limit, SearchFilter())) hits.append({hit.row, hit.score});
+    } else {
+        hits = keywordHits(connection(), queryText, limit, SearchFilter());
+    }
+    const QStringList identifiers = codeIdentifiers(queryText);
+    if (!identifiers.isEmpty()) hits = mergeKeywordHits(keywordHits(connection(), codeMatch(identifiers), limit, SearchFilter(), kCodeFts), hits, limit);
+    for (int i = 0; i < hits.size(); ++i) {
+        VectorEntry e;
+        e.id = hits[i].id;
+        e.score = hits[i].score;
+        e.keywordRank = i + 1;
+        e.keywordScore = hits[i].score;
+        results.append(e);
     }
+    hydrateEntries(results);
     return results;
 }
 
@@ -279,9 +1985,10 @@ QVector<VectorEntry> VectorStore::hybridSearch(const QString& queryText, const Q
     timer.start();
     
     QString canonicalQuery = queryText.trimmed().toLower();
+    const bool cacheable = options.filter.isEmpty(); // Cache keys carry no filter
     
     // 1. Layer 1 Cache: Exact Match
-    {
+    if (cacheable) {
         QMutexLocker locker(&m_cacheMutex);
         if (m_queryCache.contains(canonicalQuery)) {
             m_cacheHits++;
@@ -318,12 +2025,17 @@ QVector<VectorEntry> VectorStore::hybridSearch(const QString& queryText, const Q
         retrievalLimit = options.limit * 6; // Broad coverage
     }
 
+    // Identifier lookups go to the trigram table too; the weights only move towards keywords
+    // once that table has actually matched something (below)
+    const QStringList identifiers = codeIdentifiers(queryText);
+    const QString codeQuery = identifiers.isEmpty() ? QString() : codeMatch(identifiers);
+
     // Progressive Performance Budgeting (Degradation)
-    static qint64 avgLatency = 100; // Seed with 100ms
+    const qint64 avgLatency = m_avgLatency.loadRelaxed();
     bool lowLatencyMode = (avgLatency > 1500); 
     bool criticalLatency = (avgLatency > 4000); // Trigger if average > 4s
     
-    if (criticalLatency && intent != IntentType::Summary) {
+    if (criticalLatency && intent != IntentType::Summary && options.filter.isEmpty()) {
         qDebug() << "🚨 [Intelligence] CRITICAL Latency (" << avgLatency << "ms). EMERGENCY: Bypassing Vector search.";
         QVector<VectorEntry> results = ftsSearch(queryText, options.limit);
         // Minimal RRF-like injection
@@ -341,88 +2053,82 @@ QVector<VectorEntry> VectorStore::hybridSearch(const QString& queryText, const Q
     QElapsedTimer auditTimer;
     auditTimer.start();
 
-    QFuture<QVector<VectorEntry>> ftsFuture = QtConcurrent::run(m_threadPool, [this, queryText, retrievalLimit, options]() {
-        // ... (FTS thread logic remains same) ...
-        QString threadConn = QString("FTS_Thread_%1").arg(reinterpret_cast<uintptr_t>(QThread::currentThreadId()));
-        QSqlDatabase db;
-        if (QSqlDatabase::contains(threadConn)) db = QSqlDatabase::database(threadConn);
-        else { db = QSqlDatabase::cloneDatabase(m_db, threadConn); db.open(); }
-        
-        QVector<VectorEntry> results;
-        QSqlQuery q(db);
-        q.prepare("SELECT id, text_chunk, source_file, page_num, heading_path, heading_level, chunk_type, doc_id, sentence_count, list_type, list_length FROM embeddings "
-                  "WHERE id IN (SELECT rowid FROM embeddings_fts WHERE embeddings_fts MATCH :query) LIMIT :limit");
-        q.bindValue(":query", queryText);
-        q.bindValue(":limit", retrievalLimit);
-        if (q.exec()) {
-            while(q.next()) {
-                VectorEntry e;
-                e.id = q.value(0).toInt(); e.text = q.value(1).toString();
-                e.sourceFile = q.value(2).toString(); e.pageNum = q.value(3).toInt();
-                e.headingPath = q.value(4).toString(); e.headingLevel = q.value(5).toInt();
-                e.chunkType = q.value(6).toString(); e.docId = q.value(7).toString();
-                e.sentenceCount = q.value(8).toInt();                e.listType = q.value(9).toString();
-                e.listLength = q.value(10).toInt();
-                e.createdAt = q.value(11).toDateTime();
-                
-                // Phase 4.2: Trust Multiplier
-                float boost = q.value(12).toFloat();
-                qint64 secsAgo = e.createdAt.secsTo(QDateTime::currentDateTime());
-                float recencyFactor = qMax(0.5f, 1.0f - (float)secsAgo / (3600.0f * 24.0f * 30.0f));
-                e.trustScore = boost * recencyFactor;
-
-                results.append(e);
-            }
-        }
-        return results;
-    });
+    // BM25-ordered, so the head of the keyword list is its best part: half the semantic depth
+    const int keywordLimit = qMax(options.limit, retrievalLimit / 2);
+    const bool residentKeywords = m_keywordIndexEnabled; // Sub-millisecond: runs inline, no pool hop
+    QFuture<QVector<KeywordHit>> ftsFuture, codeFuture;
+    if (!residentKeywords) {
+        ftsFuture = QtConcurrent::run(m_threadPool, [this, queryText, keywordLimit, options]() {
+            return keywordHits(connection(), queryText, keywordLimit, options.filter);
+        });
+    }
+    if (!codeQuery.isEmpty()) {
+        codeFuture = QtConcurrent::run(m_threadPool, [this, codeQuery, keywordLimit, options]() {
+            return keywordHits(connection(), codeQuery, keywordLimit, options.filter, kCodeFts);
+        });
+    }
+    QVector<KeywordHit> keywordRes;
 
-    // Run Semantic Search
-    QVector<VectorEntry> semanticRes = search(queryEmbedding, retrievalLimit);
-    audit.t_vector = auditTimer.elapsed();
-    
-    QVector<VectorEntry> keywordRes = ftsFuture.result();
+    // Fusion works on (id, ranks, scores) in a per-thread arena; VectorEntry objects are only
+    // built for the candidates that survive it
+    thread_local HybridFusion fusion;
+    fusion.reset(retrievalLimit + keywordLimit);
+
+    // Run Semantic Search: ids and scores only, plus the resident chunk type / heading level
+    // the intent boost needs. Text is hydrated after fusion for the rows that survive it.
+    QVector<ScoredRow> semanticHits; // row holds the id (rows may be renumbered once the lock is released)
+    {
+        QReadLocker indexLocker(&m_indexLock);
+        for (const ScoredRow& hit : rankRows(queryEmbedding, retrievalLimit, options)) {
+            const int id = m_matrix.idAt(hit.row);
+            const QString chunkType = m_rowLabels.typeOf(hit.row);
+            const int headingLevel = m_rowLabels.level.value(hit.row, 0);
+
+            float intentBoost = 0.0f;
+            if (intent == IntentType::Definition && chunkType == "definition") intentBoost = 0.5f;
+            else if (intent == IntentType::Summary && chunkType == "summary") intentBoost = 0.5f;
+            else if (intent == IntentType::Procedure && chunkType == "list") intentBoost = 0.3f;
+            else if (intent == IntentType::Example && chunkType == "example") intentBoost = 0.4f;
+            if (intent == IntentType::Summary && headingLevel == 1) intentBoost += 0.2f;
+
+            fusion.addSemantic(id, hit.score, intentBoost);
+            semanticHits.append({id, hit.score});
+        }
+        audit.t_vector = auditTimer.elapsed();
+        if (residentKeywords) {
+            for (const ScoredRow& hit : residentKeywordHits(queryText, keywordLimit, options.filter)) keywordRes.append({hit.row, hit.score});
+        }
+    }
+    if (!residentKeywords) keywordRes = ftsFuture.result();
+    if (!codeQuery.isEmpty()) {
+        const QVector<KeywordHit> codeHits = codeFuture.result();
+        if (!codeHits.isEmpty()) {
+            // An exact identifier hit outranks paraphrases
+            weightKeyword = 0.7;
+            weightSemantic = 0.3;
+            keywordRes = mergeKeywordHits(codeHits, keywordRes, keywordLimit);
+        }
+    }
     audit.t_fts = auditTimer.elapsed() - audit.t_vector;
 
     qint64 tSearch = timer.elapsed();
-    avgLatency = (0.8 * avgLatency) + (0.2 * tSearch);
-
-    QMap<int, double> rrfScores;
-    QMap<int, VectorEntry> entryMap;
-    QMap<int, int> semanticRanks;
-    QMap<int, int> keywordRanks;
-    
-    const double K = 60.0;
-    for (int i = 0; i < semanticRes.size(); ++i) {
-        int id = semanticRes[i].id;
-        entryMap[id] = semanticRes[i];
-        semanticRanks[id] = i + 1;
-        rrfScores[id] = weightSemantic * (1.0 / (K + i + 1));
-        
-        double intentBoost = 0.0;
-        const auto& entry = semanticRes[i];
-        if (intent == IntentType::Definition && entry.chunkType == "definition") intentBoost = 0.5;
-        else if (intent == IntentType::Summary && entry.chunkType == "summary") intentBoost = 0.5;
-        else if (intent == IntentType::Procedure && entry.chunkType == "list") intentBoost = 0.3;
-        else if (intent == IntentType::Example && entry.chunkType == "example") intentBoost = 0.4;
-        if (intent == IntentType::Summary && entry.headingLevel == 1) intentBoost += 0.2;
-        rrfScores[id] += intentBoost;
-    }
+    // Concurrent queries on one store may drop each other's sample; the average only steers
+    m_avgLatency.storeRelaxed((qint64)(0.8 * m_avgLatency.loadRelaxed() + 0.2 * tSearch));
 
-    for (int i = 0; i < keywordRes.size(); ++i) {
-        int id = keywordRes[i].id;
-        keywordRanks[id] = i + 1;
-        if (!entryMap.contains(id)) entryMap[id] = keywordRes[i];
-        rrfScores[id] += weightKeyword * (1.0 / (K + i + 1));
-    }
+    for (const KeywordHit& hit : keywordRes) fusion.addKeyword(hit.id, hit.score);
 
+    // MMR re-ranks the whole fused list by doc/section, so it keeps every candidate
+    const int fused = fusion.fuse(options.fusion, weightSemantic, weightKeyword, options.experimentalMmr ? -1 : options.limit);
     QVector<VectorEntry> finalResults;
-    for (auto it = rrfScores.begin(); it != rrfScores.end(); ++it) {
-        int id = it.key();
-        VectorEntry e = entryMap[id];
-        e.score = it.value();
-        e.semanticRank = semanticRanks.value(id, 0);
-        e.keywordRank = keywordRanks.value(id, 0);
+    finalResults.reserve(fused);
+    for (int i = 0; i < fused; ++i) {
+        const HybridFusion::Candidate& c = fusion.candidates()[i];
+        VectorEntry e;
+        e.id = c.id;
+        e.score = c.score;
+        e.semanticRank = c.semanticRank;
+        e.keywordRank = c.keywordRank;
+        e.keywordScore = c.keywordScore;
         finalResults.append(e);
     }
 
@@ -430,7 +2136,7 @@ QVector<VectorEntry> VectorStore::hybridSearch(const QString& queryText, const Q
     // Phase 4.4: Intent-Aware Rank Stability (Final Regulation)
     // 1. Calculate Historical Query Stability
     float queryStability = 1.0f;
-    QSqlQuery stabilityQ(m_db);
+    QSqlQuery stabilityQ(connection());
     stabilityQ.prepare("SELECT AVG(ABS(rank_delta)) FROM retrieval_logs WHERE query = :q AND is_exploration = 0 LIMIT 10");
     stabilityQ.bindValue(":q", queryText);
     if (stabilityQ.exec() && stabilityQ.next()) {
@@ -457,77 +2163,76 @@ QVector<VectorEntry> VectorStore::hybridSearch(const QString& queryText, const Q
         return a.score > b.score;
     });
 
-    // Phase 4.1: Adaptive Multi-Level MMR+ (Experimental)
+    // Phase 4.1: Adaptive MMR over the whole fused list. It runs before hydration on resident
+    // data only: unit vectors for redundancy, doc postings and heading slots for the structural tiers.
     float mmrPenaltyTotal = 0.0f;
-    if (options.experimentalMmr && finalResults.size() > 1) {
-        // 1. Calculate Lambda (Diversity weight) via Sigmoid Query Complexity
-        // Complexity estimate: Query length + intent weight
-        float complexity = (float)queryText.split(" ").size() / 10.0f;
-        if (intent == IntentType::Summary || intent == IntentType::Procedure) complexity += 0.5f;
-        float lambda = 1.0 / (1.0 + qExp(-5.0 * (complexity - 0.5))); // Sigmoid [0.1, 0.9]
-        lambda = qBound(0.2f, (float)lambda, 0.8f); // Stability Clamp
-        
-        // 2. Document Distribution Entropy (EMA Smoothed)
-        QMap<QString, int> docCounts;
-        for (const auto& res : finalResults) docCounts[res.docId]++;
-        
-        double currentEntropy = 0.0;
-        for (int count : docCounts.values()) {
-            double p = (double)count / finalResults.size();
-            currentEntropy -= p * qLn(p) / qLn(2.0);
-        }
-        
-        // Session-aware EMA update
-        double alpha = (m_sessionSearchCount < 10) ? 0.3 : 0.1; // Respond faster to new domains early on
-        m_avgDocEntropy = (alpha * currentEntropy) + (1.0 - alpha) * m_avgDocEntropy;
-        m_sessionSearchCount++;
-        
-        // 3. Iterative Selection (MMR Greedy)
-        QVector<VectorEntry> diverseResults;
-        QSet<QString> selectedDocs;
-        QSet<QString> selectedPaths;
-        
-        // Always take Top 1
-        diverseResults.append(finalResults.takeFirst());
-        selectedDocs.insert(diverseResults.first().docId);
-        selectedPaths.insert(diverseResults.first().headingPath);
-        
-        while (diverseResults.size() < options.limit && !finalResults.isEmpty()) {
-            int bestIdx = -1;
-            double bestMmrScore = -1e9;
-            float currentPenalty = 0.0f;
-            
-            for (int i = 0; i < finalResults.size(); ++i) {
-                const auto& candidate = finalResults[i];
-                
-                // Multi-Tier Diversity Penalty
-                float diversityPenalty = 0.0f;
-                // Tier 1: Document overlap (Doc Entropy aware)
-                if (selectedDocs.contains(candidate.docId)) {
-                    diversityPenalty += 0.15f * (1.1 - m_avgDocEntropy); 
-                }
-                // Tier 2: Sectional overlap
-                if (selectedPaths.contains(candidate.headingPath)) {
-                    diversityPenalty += 0.1f;
-                }
-                
-                double mmrScore = lambda * candidate.score - (1.0f - lambda) * diversityPenalty;
-                if (mmrScore > bestMmrScore) {
-                    bestMmrScore = mmrScore;
-                    bestIdx = i;
-                    currentPenalty = diversityPenalty;
+    {
+        QReadLocker indexLocker(&m_indexLock);
+        if (options.experimentalMmr && finalResults.size() > 1) {
+            // 1. Calculate Lambda (Diversity weight) via Sigmoid Query Complexity
+            // Complexity estimate: Query length + intent weight
+            float complexity = (float)queryText.split(" ").size() / 10.0f;
+            if (intent == IntentType::Summary || intent == IntentType::Procedure) complexity += 0.5f;
+            float lambda = 1.0 / (1.0 + qExp(-5.0 * (complexity - 0.5))); // Sigmoid [0.1, 0.9]
+            lambda = qBound(0.2f, (float)lambda, 0.8f); // Stability Clamp
+
+            // Candidates as (relevance, vector, document, section); fused scores min-max scaled
+            // so relevance and cosine redundancy share one range
+            double lo = finalResults.first().score, hi = lo;
+            for (const auto& res : finalResults) {
+                lo = qMin(lo, res.score);
+                hi = qMax(hi, res.score);
+            }
+            QHash<int, int> docKeys; // Doc ordinal -> group, numbered in order of appearance
+            QVector<int> docCounts;
+            QVector<MmrSelector::Candidate> candidates;
+            candidates.reserve(finalResults.size());
+            for (const auto& res : finalResults) {
+                const int row = rowOf(res.id);
+                MmrSelector::Candidate c;
+                c.relevance = hi > lo ? float((res.score - lo) / (hi - lo)) : 1.0f;
+                c.vector = row >= 0 ? m_matrix.row(row) : nullptr;
+                c.group = -1;
+                c.section = row >= 0 && row < m_rowHeading.size() ? m_rowHeading[row] : -1;
+                const int doc = m_rowLabels.doc.value(row, -1);
+                if (doc >= 0) {
+                    if (!docKeys.contains(doc)) {
+                        docKeys.insert(doc, docKeys.size());
+                        docCounts.append(0);
+                    }
+                    c.group = docKeys.value(doc);
+                    docCounts[c.group]++;
                 }
+                candidates.append(c);
+            }
+
+            // 2. Document Distribution Entropy (EMA Smoothed)
+            double currentEntropy = 0.0;
+            for (int count : docCounts) {
+                double p = (double)count / finalResults.size();
+                currentEntropy -= p * qLn(p) / qLn(2.0);
             }
-            
-            if (bestIdx != -1) {
-                VectorEntry selected = finalResults.takeAt(bestIdx);
-                mmrPenaltyTotal += currentPenalty;
-                diverseResults.append(selected);
-                selectedDocs.insert(selected.docId);
-                selectedPaths.insert(selected.headingPath);
-            } else break;
+
+            // Session-aware EMA update
+            double alpha = (m_sessionSearchCount < 10) ? 0.3 : 0.1; // Respond faster to new domains early on
+            m_avgDocEntropy = (alpha * currentEntropy) + (1.0 - alpha) * m_avgDocEntropy;
+            m_sessionSearchCount++;
+
+            // 3. Greedy selection: embedding redundancy plus the document / section tiers
+            MmrSelector mmr;
+            mmr.lambda = lambda;
+            mmr.groupPenalty = 0.15f * (1.1 - m_avgDocEntropy); // Doc Entropy aware
+            mmr.sectionPenalty = 0.1f;
+            QVector<float> penalties;
+            QVector<VectorEntry> diverseResults;
+            for (int i : mmr.select(candidates, m_matrix.dimension(), options.limit, &penalties)) diverseResults.append(finalResults[i]);
+            for (float penalty : penalties) mmrPenaltyTotal += penalty;
+            finalResults = diverseResults;
         }
-        finalResults = diverseResults;
+
+        // Lazy hydration: one query for the rows that can still be returned
+        if (finalResults.size() > options.limit) finalResults.resize(options.limit);
+        hydrateEntries(finalResults);
     }
 
     // Phase 4.3: Budgeted Uncertainty Exploration (Experimental)
@@ -541,8 +2246,19 @@ QVector<VectorEntry> VectorStore::hybridSearch(const QString& queryText, const Q
         // Find a "Cold Pool" candidate: boost_factor = 1.0 (no clicks), semantic similarity [0.65, 0.85]
         // For simplicity, we scan current semantic results for a high-uncertainty candidate
         // that hasn't made it to the Top 5 yet.
-        for (int i = options.limit; i < semanticRes.size(); ++i) {
-            VectorEntry& candidate = semanticRes[i];
+        QVector<VectorEntry> coldPool;
+        for (int i = options.limit; i < semanticHits.size(); ++i) {
+            VectorEntry e;
+            e.id = semanticHits[i].row;
+            e.score = semanticHits[i].score;
+            coldPool.append(e);
+        }
+        {
+            QReadLocker indexLocker(&m_indexLock);
+            hydrateEntries(coldPool);
+        }
+        for (int i = 0; i < coldPool.size(); ++i) {
+            VectorEntry& candidate = coldPool[i];
             if (candidate.trustScore <= 1.0f && candidate.score > 0.65) {
                 candidate.isExploration = true;
                 candidate.score = finalResults.first().score * 0.95; // Inject just below Rank 1
@@ -557,7 +2273,7 @@ QVector<VectorEntry> VectorStore::hybridSearch(const QString& queryText, const Q
     audit.t_mmr = auditTimer.elapsed() - audit.t_fts - audit.t_vector;
     
     // Cache the result
-    {
+    if (cacheable) {
         QMutexLocker locker(&m_cacheMutex);
         m_queryCache.insert(canonicalQuery, new QVector<VectorEntry>(finalResults));
         m_cacheMisses++;
@@ -582,7 +2298,7 @@ void VectorStore::logRetrieval(const QString& query, int sRank, int kRank, int f
                               int lEmbed, int lSearch, int lFusion, int lRerank, double topScore,
                               float mmrPenalty, bool isExploration, int rankDelta, float stability) {
     if (!m_db.isOpen()) return;
-    QSqlQuery q(m_db);
+    QSqlQuery q(connection());
     q.prepare("INSERT INTO retrieval_logs (query, semantic_rank, keyword_rank, final_rank, "
               "latency_embed, latency_search, latency_fusion, latency_rerank, top_score, "
               "mmr_penalty, is_exploration, rank_delta, mmr_decay) " // Reusing mmr_decay slot for stability or adding column
@@ -610,27 +2326,18 @@ void VectorStore::logRetrieval(const QString& query, int sRank, int kRank, int f
 void VectorStore::warmup() {
     // Runnable for low-priority background warmup
     class WarmupTask : public QRunnable {
-        QSqlDatabase m_parentDb;
+        const VectorStore* m_store;
     public:
-        WarmupTask(QSqlDatabase db) : m_parentDb(db) {}
+        WarmupTask(const VectorStore* store) : m_store(store) {}
         void run() override {
-            QString threadConn = QString("Warmup_Thread_%1").arg(reinterpret_cast<uintptr_t>(QThread::currentThreadId()));
-            QSqlDatabase db;
-            if (QSqlDatabase::contains(threadConn)) {
-                db = QSqlDatabase::database(threadConn);
-            } else {
-                db = QSqlDatabase::cloneDatabase(m_parentDb, threadConn);
-                db.open();
-            }
-            
-            QSqlQuery q("SELECT COUNT(id) FROM embeddings", db);
+            QSqlQuery q("SELECT COUNT(id) FROM embeddings", m_store->connection());
             q.exec();
             qDebug() << "Database warmup complete.";
         }
     };
     
     // Start at low priority to avoid blocking UI or search
-    m_threadPool->start(new WarmupTask(m_db), -1); 
+    m_threadPool->start(new WarmupTask(this), -1); 
 }
 
 int VectorStore::count() {
@@ -642,14 +2349,71 @@ int VectorStore::count() {
 void VectorStore::clear() {
     QSqlQuery query(m_db);
     query.exec("DELETE FROM embeddings");
+    // External-content FTS tables don't follow their content table: drop their postings too
+    query.exec("INSERT INTO embeddings_fts(embeddings_fts) VALUES('delete-all')");
+    query.exec("INSERT INTO embeddings_code_fts(embeddings_code_fts) VALUES('delete-all')");
     query.exec("DELETE FROM workspace_metadata WHERE key = 'embedding_dimension'");
+    {
+        QMutexLocker locker(&m_cacheMutex);
+        m_queryCache.clear();
+        m_semanticCache.clear();
+    }
+    cancelIndexTraining();
+    QWriteLocker locker(&m_indexLock);
+    m_matrix.clear();
+    m_vectorFile.remove();
+    m_sq8.clear();
+    m_bits.clear();
+    m_reduced.clear();
+    m_docRows.clear();
+    m_typeRows.clear();
+    m_levelRows.clear();
+    m_rowLabels.clear();
+    m_tombstones = RowBitmap();
+    m_deadRows = 0;
+    m_rowHeading.clear();
+    m_headingVecs.clear();
+    m_headingSlots.clear();
+    m_keywordIndex.clear();
+    selectScoreKernel(0);
+    m_pqCodes.clear(); // Codebook and projection stay valid for new rows
+    if (m_annIndex) {
+        m_annIndex->clear();
+        m_annDirty = true;
+    }
 }
 
 void VectorStore::close() {
+    cancelIndexTraining();
+    saveAnnIndex();
+    m_annIndex.reset();
+    m_pq = ProductQuantizer();
+    m_pqCodes.clear();
+    m_sq8.clear();
+    m_bits.clear();
+    m_pca = PcaProjection();
+    m_reduced.clear();
+    m_docRows.clear();
+    m_typeRows.clear();
+    m_levelRows.clear();
+    m_rowLabels.clear();
+    m_tombstones = RowBitmap();
+    m_deadRows = 0;
+    m_rowHeading.clear();
+    m_headingVecs.clear();
+    m_headingSlots.clear();
+    m_keywordIndex.clear();
+    m_keywordIndexEnabled = false;
+    m_matrix.clear();
+    m_vectorFile.close(); // Unmapped only after the matrix stopped pointing into it
     if (m_db.isOpen()) m_db.close();
     QString connectionName = m_db.connectionName();
     m_db = QSqlDatabase(); 
     QSqlDatabase::removeDatabase(connectionName);
+    // Worker clones still point at this file; the next init() may open another one
+    for (const QString& name : QSqlDatabase::connectionNames()) {
+        if (name.startsWith(m_connectionName + "_Thread_")) QSqlDatabase::removeDatabase(name);
+    }
 }
 
 void VectorStore::setPath(const QString& name) { m_dbPath = name; }
@@ -671,17 +2435,11 @@ bool VectorStore::exportToCsv(const QString& filePath) {
 }
 
 QByteArray VectorStore::vectorToBlob(const QVector<float>& vec) {
-    QByteArray blob;
-    blob.append(reinterpret_cast<const char*>(vec.data()), vec.size() * sizeof(float));
-    return blob;
+    return VectorBlob::encode(vec.constData(), vec.size(), m_blobType);
 }
 
 QVector<float> VectorStore::blobToVector(const QByteArray& blob) {
-    QVector<float> vec;
-    int count = blob.size() / sizeof(float);
-    vec.resize(count);
-    memcpy(vec.data(), blob.constData(), blob.size());
-    return vec;
+    return VectorBlob::decode(blob);
 }
 
 QString VectorStore::getContext(const QString& docId, int currentIdx, int offset) {
@@ -749,16 +2507,11 @@ SourceContext VectorStore::getSourceContext(VectorEntry entry, int offset, const
 
 double VectorStore::cosineSimilarity(const QVector<float>& v1, const QVector<float>& v2) {
     if (v1.size() != v2.size() || v1.isEmpty()) return 0.0;
-    double dotProduct = 0.0;
-    double norm1 = 0.0;
-    double norm2 = 0.0;
-    for (int i = 0; i < v1.size(); ++i) {
-        dotProduct += v1[i] * v2[i];
-        norm1 += v1[i] * v1[i];
-        norm2 += v2[i] * v2[i];
-    }
-    if (norm1 == 0.0 || norm2 == 0.0) return 0.0;
-    return dotProduct / (qSqrt(norm1) * qSqrt(norm2));
+    return cosineSimilarity(v1.constData(), v2.constData(), v1.size());
+}
+
+double VectorStore::cosineSimilarity(const float* v1, const float* v2, int dim) {
+    return SimdKernels::cosine(v1, v2, dim);
 }
 
 void VectorStore::setMetadata(const QString& key, const QString& value) {
@@ -2,6 +2,8 @@
 #define VECTOR_STORE_H
 
 #include <QString>
+#include <QStringList>
+#include <QHash>
 #include <QSqlDatabase>
 #include <QVector>
 #include <QByteArray>
@@ -9,6 +11,24 @@
 #include <QMutex>
 #include <QThreadPool>
 #include <QDateTime>
+#include <QReadWriteLock>
+#include <QAtomicInt>
+#include <QFuture>
+#include "vector_matrix.h"
+#include "simd_kernels.h"
+#include "vector_file.h"
+#include "sq8_matrix.h"
+#include "binary_matrix.h"
+#include "row_bitmap.h"
+#include "row_labels.h"
+#include "vector_blob.h"
+#include "pca_projection.h"
+#include "hnsw_index.h"
+#include "ivf_index.h"
+#include "product_quantizer.h"
+#include "inverted_index.h"
+#include "hybrid_fusion.h"
+#include <memory>
 
 struct VectorEntry {
     int id;
@@ -27,6 +47,7 @@ struct VectorEntry {
     double score; // For search results
     int semanticRank = 0;
     int keywordRank = 0;
+    double keywordScore = 0.0; // BM25 of the keyword hit (0 = not matched)
     int rerankRank = 0;
     QDateTime createdAt;
     float trustScore = 1.0f;
@@ -79,15 +100,39 @@ struct SearchAudit {
     qint64 t_synthesis = 0;
 };
 
+// Metadata restriction for search()/hybridSearch(). Fields combine with AND, list entries
+// with OR; an empty field does not restrict. Compiled into a row bitmap before the scan.
+struct SearchFilter {
+    QStringList docIds;
+    QStringList chunkTypes;
+    QString headingPath; // Heading subtree: this heading and everything nested under it
+    int minPage = 0;     // Inclusive page range (0 = unbounded)
+    int maxPage = 0;
+
+    bool isEmpty() const {
+        return docIds.isEmpty() && chunkTypes.isEmpty() && headingPath.isEmpty() && minPage <= 0 && maxPage <= 0;
+    }
+};
+
 struct SearchOptions {
     int limit = 5;
     bool enableStreaming = true;
     bool highPriority = true;
     float semanticThreshold = 0.95f;
     bool deterministic = false; // Benchmarking flag
-    bool experimentalMmr = false; // Toggle for Phase 4.1 logic
+    bool experimentalMmr = true; // Phase 4.1 MMR diversification (embedding-aware, cheap enough to leave on)
     bool enableExploration = false; // Toggle for Phase 4.3 logic
     bool useRerank = false; // Added missing member
+    int efSearch = 0; // HNSW candidate list size per query (0 = index default); higher = better recall
+    int nprobe = 0;   // IVF lists scanned per query (0 = index default); higher = better recall
+    int pqRescore = 0; // PQ candidates re-scored at full precision (0 = 4 x limit)
+    int sq8Oversample = 4; // Above 50k candidate rows, an int8 scan re-scores limit x oversample rows in float (0 = always exact)
+    bool binaryPrefilter = false; // Broad-recall mode: popcount Hamming shortlist over 1-bit sketches first
+    int binaryShortlist = 0;      // Hamming survivors re-scored in float (0 = 20 x limit)
+    int pcaShortlist = 0;         // Reduced-dim survivors re-scored at full dim (0 = 10 x limit)
+    SearchFilter filter;          // Non-matching rows are skipped by every tier, not post-filtered
+    float headingWeight = 0.2f;   // Share of the heading-path vector in the semantic score (0 = chunk vector only)
+    FusionMethod fusion = FusionMethod::Rrf; // How hybridSearch() merges the semantic and keyword lists
 };
 
 class VectorStore : public QObject {
@@ -103,6 +148,16 @@ public:
                   const QString& path = "", int level = 0,
                   const QString& chunkType = "text",
                   int sCount = 0, const QString& lType = "", int lLen = 0);
+    
+    // Removes rows from SQLite/FTS at once; resident tiers tombstone them until compaction
+    int deleteEntries(const QVector<int>& ids);
+    int deleteDocument(const QString& docId);
+    bool compactIndex(); // Async on m_threadPool; drops tombstoned rows from every tier; false if busy/nothing to drop
+    int tombstoneCount() const { return m_deadRows; }
+    
+    // Heading-path embeddings (embeddings.heading_vec_blob), computed once per distinct path
+    bool hasHeadingVector(const QString& headingPath) const;
+    bool setHeadingVector(const QString& headingPath, const QVector<float>& embedding);
                   
     void boostEntry(int entryId, float amount);
     void addInteraction(int entryId, const QString& query, bool isExploration = false);
@@ -110,7 +165,9 @@ public:
     QString getContext(const QString& docId, int currentIdx, int offset = 1);
     SourceContext getSourceContext(VectorEntry entry, int offset = 1, const QString& stage = "hybrid");
                   
-    QVector<VectorEntry> search(const QVector<float>& queryEmbedding, int limit = 5);
+    QVector<VectorEntry> search(const QVector<float>& queryEmbedding, int limit = 5, const SearchOptions& options = SearchOptions());
+    // Exact top-k for many queries in one blocked pass over the corpus (offline eval / bulk jobs)
+    QVector<QVector<VectorEntry>> searchBatch(const QVector<QVector<float>>& queries, int k);
     QVector<VectorEntry> ftsSearch(const QString& queryText, int limit = 5);
     QVector<VectorEntry> hybridSearch(const QString& queryText, const QVector<float>& queryEmbedding, const SearchOptions& options = SearchOptions());
     
@@ -142,6 +199,31 @@ public:
     int getRegisteredDimension();
     void setRegisteredDimension(int dim);
     
+    // On-disk vector precision (workspace_metadata 'vector_dtype'). Workspaces that predate v19
+    // stay float32; converting rewrites every blob and VACUUMs, async on m_threadPool (false if busy)
+    VectorBlob::Type vectorStorageType() const { return m_blobType; }
+    bool setVectorStorageType(VectorBlob::Type type);
+    qint64 storageBytes() const; // The .sqlite file plus its WAL and sidecars (.vec/.vid, ANN index)
+    
+    // Approximate nearest-neighbour index (persisted as a sidecar next to the .sqlite)
+    bool buildHnswIndex(const HnswParams& params = HnswParams()); // Async on m_threadPool; false if busy
+    bool trainIvfIndex(const IvfParams& params = IvfParams()); // Async on m_threadPool; false if busy/empty
+    bool isIndexTraining() const { return m_trainFuture.isRunning(); }
+    
+    // Product-quantized scan: codes persist in embeddings.pq_codes, codebook in pq_codebook
+    bool trainPqCodec(int subspaces = 96, int iterations = 20); // Async on m_threadPool; false if busy/empty
+    bool hasPqCodec() const { return m_pq.isTrained(); }
+    
+    // PCA cascade: projection in workspace_metadata 'pca_projection', reduced rows in embeddings.pca_blob
+    bool trainPcaProjection(int components = 192, int iterations = 4); // Async on m_threadPool; false if busy/empty
+    bool hasPcaProjection() const { return m_pca.isTrained(); }
+    void dropAnnIndex();
+    bool hasAnnIndex() const { return m_annIndex != nullptr; }
+    
+    // Resident BM25 index serving the keyword stage instead of FTS5 (workspace_metadata 'keyword_index')
+    bool setKeywordIndexEnabled(bool enabled);
+    bool keywordIndexEnabled() const { return m_keywordIndexEnabled; }
+    
     // Phase 4.0 Observability State
     bool m_benchmarkingMode = false;
     int m_benchSeed = 42;
@@ -152,7 +234,84 @@ public:
 
 private:
     QString m_dbPath;
+    QString m_connectionName;
     QSqlDatabase m_db;
+    QSqlDatabase connection() const; // m_db on the owner thread, else a per-thread clone
+    
+    // Resident embedding matrix (loaded once in init, kept in sync by addEntry/clear)
+    VectorMatrix m_matrix;
+    VectorFile m_vectorFile; // Mapped .vec/.vid sidecar backing m_matrix's rows, plus the .vlb labels log
+    bool attachVectorFile(int dim, int expected);
+    bool attachRowLabels(int expected); // Labels, sketches and postings from the .vlb; false = fall back to the table
+    Sq8Matrix m_sq8; // Int8 copy of m_matrix for the quantized scan tier
+    BinaryMatrix m_bits; // Sign-bit sketch of m_matrix, kept in the .vlb beside a mapped sidecar
+    void loadMatrix();
+    // Mapped opens leave the SQL-backed tiers (sq8, PQ codes, PCA rows) to this job; searches
+    // scan without them until it installs. trainPq/trainPca/compact wait for it to finish.
+    QFuture<void> m_tierFuture;
+    void loadStoredTiers();
+    // Row scoring kernel fixed to the workspace dimension (SimdKernels::scoreKernel)
+    SimdKernels::ScoreFn m_scoreKernel = SimdKernels::dot;
+    int m_kernelDim = 0;
+    void selectScoreKernel(int dim);
+    // Scoring works on row ordinals / ids; text and metadata are fetched afterwards in one
+    // IN query for the survivors. All four expect the caller to hold the index lock.
+    QVector<ScoredRow> rankRows(const QVector<float>& queryEmbedding, int limit, const SearchOptions& options);
+    QVector<VectorEntry> hydrateHits(const QVector<ScoredRow>& hits);
+    void hydrateEntries(QVector<VectorEntry>& entries); // Fills entries carrying only id/score; drops vanished ids
+    int rowOf(int id) const; // -1 when the id has no resident row
+    
+    // Built from text_chunk/heading_path at open when enabled, kept in sync by addEntry/deleteEntries
+    InvertedIndex m_keywordIndex;
+    bool m_keywordIndexEnabled = false;
+    void loadKeywordIndex(); // Caller holds the write lock
+    QVector<ScoredRow> residentKeywordHits(const QString& queryText, int limit, const SearchFilter& filter); // Caller holds the index lock
+    
+    // Posting bitmaps over row ordinals, maintained alongside m_matrix
+    QHash<QString, RowBitmap> m_docRows;
+    QHash<QString, RowBitmap> m_typeRows;
+    QHash<int, RowBitmap> m_levelRows; // heading_level
+    RowLabels m_rowLabels; // The inverse, one ordinal per row
+    bool compileFilter(const SearchFilter& filter, RowBitmap& allowed); // Caller holds the index lock; false = no restriction
+    
+    // Deleted rows still resident (until compactIndex), excluded from every search
+    RowBitmap m_tombstones;
+    int m_deadRows = 0;
+    bool m_rowsRenumbered = false; // loadMatrix fell back from a sidecar: ANN ordinals are stale
+    
+    // One unit vector per distinct heading_path; m_rowHeading maps each matrix row to its slot (-1 = none)
+    VectorMatrix m_headingVecs;
+    QHash<QString, int> m_headingSlots;
+    QVector<int> m_rowHeading;
+    void loadHeadingVectors();
+    int normalizeStoredVectors(); // v16 backfill: unit-length blobs + original norm
+    int quantizeStoredVectors();  // v18 backfill: sq8_blob from the unit-length blobs
+    int convertStoredVectors(VectorBlob::Type type, int generation); // Re-encodes vector_blob in place; stops once stale
+    VectorBlob::Type m_blobType = VectorBlob::Type::Float32;
+    
+    std::unique_ptr<IVectorIndex> m_annIndex;
+    bool m_annDirty = false;
+    QString sidecarPath(const QString& extension) const;
+    void loadAnnIndex();
+    void saveAnnIndex();
+    void installAnnIndex(std::unique_ptr<IVectorIndex> index); // Caller holds the write lock
+    
+    // Guards m_matrix/m_annIndex against the background IVF trainer. The generation is
+    // bumped by clear/close/drop so a trainer that started before them discards its result.
+    mutable QReadWriteLock m_indexLock;
+    QAtomicInt m_indexGeneration;
+    QFuture<void> m_trainFuture;
+    void cancelIndexTraining();
+    
+    ProductQuantizer m_pq;
+    QVector<uchar> m_pqCodes; // rows x codeSize, aligned with m_matrix
+    void loadPqCodec();
+    void persistPqCodes(); // Caller holds the index lock
+    
+    PcaProjection m_pca;
+    VectorMatrix m_reduced; // Projected rows, aligned with m_matrix
+    void loadPcaProjection();
+    void persistPcaRows(); // Caller holds the index lock
     
     // Phase 3A: High-Performance Infrastructure
     QThreadPool* m_threadPool;
@@ -165,6 +324,9 @@ private:
     };
     QVector<SemanticCacheEntry> m_semanticCache; // Layer 2: Semantic Similarity
     QMutex m_cacheMutex;
+    // Moving average of hybridSearch latency (ms) for this workspace; federated searches
+    // query several stores at once on the pool
+    QAtomicInteger<qint64> m_avgLatency;
     
     // Diagnostic stats
     int m_cacheHits = 0;
@@ -173,6 +335,7 @@ private:
     QByteArray vectorToBlob(const QVector<float>& vec);
     QVector<float> blobToVector(const QByteArray& blob);
     double cosineSimilarity(const QVector<float>& v1, const QVector<float>& v2);
+    static double cosineSimilarity(const float* v1, const float* v2, int dim);
 };
 
 #endif // VECTOR_STORE_H